@@ -0,0 +1,363 @@
+/*
+    aot - Ahead-of-time compiler from PM/0 code to C and native executables
+
+    Reads the code ./vm runs (elf.txt or a .pmo object) and writes one C
+    translation unit with a label for every instruction that is jumped
+    or returned to, so the C compiler sees the program's real control
+    flow:
+
+    - When the expression stack depth is known at every instruction
+      (always, for parsercodegen's code), stack slot d is the local sd:
+      straight-line LIT/LOD/OPR/STO runs become register operations and
+      only variables live in the stack array, laid out as in the VM.
+    - Otherwise every instruction works on the stack array exactly as
+      the VM does.
+    - The stack depths come from jit_depths() in jit.c.
+    - RTN jumps through a switch over the return points of the CALs.
+    - SYS write/read go through printf/scanf like the VM, and the VM's
+      run-time checks (division by zero, stack overflow and underflow,
+      active calls, RTN through overwritten links) stop with its messages
+      and status.
+
+    To Compile:
+        gcc -O2 -std=c11 -DVM_LIBRARY -DOBJECT_LIBRARY -o aot aot.c vm.c jit.c object.c
+
+    To Execute:
+        ./aot <code file> <out.c>
+        ./aot --cc <code file> <program>
+    where:
+        <code file> is an elf.txt written by parsercodegen or a .pmo object
+        --cc writes <program>.c and builds <program> from it with $CC
+             (default cc) -O2
+        an output that is the code file itself is refused
+    Notes:
+    - Superinstructions (parsercodegen --fuse) compile as the plain
+      instructions they cover, as in the JIT.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "aot.h"
+#include "jit.h"
+#include "vm.h"
+
+
+
+// the plain instruction a superinstruction's own slot holds
+static int plain_op(int op) {
+    if (op == LLOS || op == LLOJ) return LOD;
+    if (op == LSTO) return LIT;
+    return op;
+}
+
+
+// the checks vm_decode() makes; returns 0 if code[i] can run
+static int check_instruction(const instruction *in, int count) {
+    switch (plain_op(in->op)) {
+        case LIT: return 0;
+        case OPR: return in->m >= RTN && in->m <= EVEN ? 0 : -1;
+        case LOD:
+        case STO: return in->l >= 0 && in->l <= VM_MAX_CALLS && in->m >= 0 && in->m < VM_STACK_SIZE ? 0 : -1;
+        case INC: return in->m >= 0 ? 0 : -1;
+        case CAL:
+            if (in->l < 0 || in->l > VM_MAX_CALLS) return -1;
+            // fall through
+        case JMP:
+        case JPC: return in->m % 3 == 0 && in->m >= 0 && CODE_INDEX(in->m) <= count ? 0 : -1;
+        case SYS: return in->m >= SYS_WRITE && in->m <= SYS_HALT ? 0 : -1;
+    }
+    return -1;
+}
+
+
+// an int literal; -2147483648 isn't one in C
+static const char *literal(int value, char *buf, size_t size) {
+    if (value == -2147483647 - 1) snprintf(buf, size, "(-2147483647 - 1)");
+    else snprintf(buf, size, "%d", value);
+    return buf;
+}
+
+
+static void put_goto(FILE *out, int target, int count) {
+    if (target >= count) fprintf(out, "goto halt;");
+    else fprintf(out, "goto L%d;", target);
+}
+
+
+// one instruction with the expression stack in locals s0, s1, ... (d on entry)
+static void emit_registers(FILE *out, const instruction *in, int index, int count, int d) {
+    static const char *arith[] = {"", "+", "-", "*"};
+    static const char *relation[] = {"==", "!=", "<", "<=", ">", ">="};
+    char buf[32];
+    switch (plain_op(in->op)) {
+        // pushes check the stack the VM would push onto
+        case LIT: fprintf(out, "PUSH_ROOM(%d); s%d = %s;", d, d, literal(in->m, buf, sizeof(buf))); break;
+        case LOD:
+            if (in->l == 0) fprintf(out, "PUSH_ROOM(%d); s%d = stack[bp - %d];", d, d, in->m);
+            else fprintf(out, "PUSH_ROOM(%d); s%d = stack[base(bp, %d) - %d];", d, d, in->l, in->m);
+            break;
+        case STO:
+            if (in->l == 0) fprintf(out, "stack[bp - %d] = s%d;", in->m, d - 1);
+            else fprintf(out, "stack[base(bp, %d) - %d] = s%d;", in->l, in->m, d - 1);
+            break;
+        case OPR:
+            if (in->m == RTN) {
+                fprintf(out, "RETURN;");
+            } else if (in->m == EVEN) {
+                fprintf(out, "s%d = s%d %% 2 == 0;", d - 1, d - 1);
+            } else if (in->m == DIV) {
+                fprintf(out, "if (s%d == 0) return fail(\"division by zero\"); s%d = divide(s%d, s%d);", d - 1, d - 2, d - 2, d - 1);
+            } else if (in->m <= MUL) {
+                // wrap like the VM does instead of relying on signed overflow
+                fprintf(out, "s%d = (int)((unsigned)s%d %s (unsigned)s%d);", d - 2, d - 2, arith[in->m], d - 1);
+            } else {
+                fprintf(out, "s%d = s%d %s s%d;", d - 2, d - 2, relation[in->m - EQL], d - 1);
+            }
+            break;
+        case CAL:
+            fprintf(out, "CALL(base(bp, %d), %d); ", in->l, index + 1);
+            put_goto(out, CODE_INDEX(in->m), count);
+            break;
+        case INC: fprintf(out, "sp -= %d; if (sp < 0) return fail(\"stack overflow\");", in->m); break;
+        case JMP: put_goto(out, CODE_INDEX(in->m), count); break;
+        case JPC:
+            fprintf(out, "if (s%d == 0) ", d - 1);
+            put_goto(out, CODE_INDEX(in->m), count);
+            break;
+        case SYS:
+            if (in->m == SYS_WRITE) fprintf(out, "printf(\"%%d\\n\", s%d);", d - 1);
+            else if (in->m == SYS_READ) fprintf(out, "PUSH_ROOM(%d); s%d = read_int();", d, d);
+            else fprintf(out, "goto halt;");
+            break;
+    }
+}
+
+
+// one instruction on the stack array, as vm.c runs it
+static void emit_stack(FILE *out, const instruction *in, int index, int count) {
+    static const char *arith[] = {"", "+", "-", "*"};
+    static const char *relation[] = {"==", "!=", "<", "<=", ">", ">="};
+    char frame[32];
+    if (in->l == 0) snprintf(frame, sizeof(frame), "bp");
+    else snprintf(frame, sizeof(frame), "base(bp, %d)", in->l);
+    switch (plain_op(in->op)) {
+        case LIT: fprintf(out, "PUSH_ROOM(0); stack[--sp] = %s;", literal(in->m, frame, sizeof(frame))); break;
+        case LOD: fprintf(out, "PUSH_ROOM(0); stack[sp - 1] = stack[%s - %d]; sp--;", frame, in->m); break;
+        case STO: fprintf(out, "POPS(1); stack[%s - %d] = stack[sp++];", frame, in->m); break;
+        case OPR:
+            if (in->m == RTN) {
+                fprintf(out, "RETURN;");
+            } else if (in->m == EVEN) {
+                fprintf(out, "POPS(1); stack[sp] = stack[sp] %% 2 == 0;");
+            } else if (in->m == DIV) {
+                fprintf(out, "POPS(2); if (stack[sp] == 0) return fail(\"division by zero\"); sp++; stack[sp] = divide(stack[sp], stack[sp - 1]);");
+            } else if (in->m <= MUL) {
+                fprintf(out, "POPS(2); sp++; stack[sp] = (int)((unsigned)stack[sp] %s (unsigned)stack[sp - 1]);", arith[in->m]);
+            } else {
+                fprintf(out, "POPS(2); sp++; stack[sp] = stack[sp] %s stack[sp - 1];", relation[in->m - EQL]);
+            }
+            break;
+        case CAL:
+            fprintf(out, "CALL(%s, %d); ", frame, index + 1);
+            put_goto(out, CODE_INDEX(in->m), count);
+            break;
+        case INC: fprintf(out, "sp -= %d; if (sp < 0) return fail(\"stack overflow\");", in->m); break;
+        case JMP: put_goto(out, CODE_INDEX(in->m), count); break;
+        case JPC:
+            fprintf(out, "POPS(1); if (stack[sp++] == 0) ");
+            put_goto(out, CODE_INDEX(in->m), count);
+            break;
+        case SYS:
+            if (in->m == SYS_WRITE) fprintf(out, "POPS(1); printf(\"%%d\\n\", stack[sp++]);");
+            else if (in->m == SYS_READ) fprintf(out, "PUSH_ROOM(0); stack[--sp] = read_int();");
+            else fprintf(out, "goto halt;");
+            break;
+    }
+}
+
+
+int aot_write_c(const instruction *code, int count, const char *origin, FILE *out) {
+    for (int i = 0; i < count; i++) {
+        if (check_instruction(&code[i], count) < 0) {
+            fprintf(stderr, "Error: invalid instruction %d: %d %d %d\n", i, code[i].op, code[i].l, code[i].m);
+            return -1;
+        }
+    }
+
+    // labels: jump and call targets, and the return point after each CAL
+    char *is_label = calloc((size_t)count + 1, 1);
+    char *is_return = calloc((size_t)count + 1, 1);
+    if (!is_label || !is_return) {
+        fprintf(stderr, "Error: out of memory.\n");
+        free(is_label);
+        free(is_return);
+        return -1;
+    }
+    int has_rtn = 0;
+    for (int i = 0; i < count; i++) {
+        int op = plain_op(code[i].op);
+        if (op == JMP || op == JPC || op == CAL) is_label[CODE_INDEX(code[i].m)] = 1;
+        if (op == CAL) is_label[i + 1] = is_return[i + 1] = 1;
+        if (op == OPR && code[i].m == RTN) has_rtn = 1;
+    }
+    int max_depth = 0;
+    int *depth = jit_depths(code, count, &max_depth);
+    if (!depth) max_depth = 0;
+
+    fprintf(out, "/* %s: %d PM/0 instructions compiled by aot (%s) */\n\n", origin, count,
+            depth ? "expression stack in locals" : "expression stack in memory");
+    fprintf(out, "#include <stdio.h>\n#include <stdlib.h>\n\n");
+    fprintf(out, "#define STACK_SIZE %d\n", VM_STACK_SIZE);
+    fprintf(out, "#define MAX_CALLS %d\n", VM_MAX_CALLS);
+    fprintf(out, "#define CODE_COUNT %d\n", count);
+    fprintf(out, "\n");
+    // the VM's run-time checks (vm_exec() in vm.c)
+    // PUSH_ROOM(d): d words of the expression stack are already in locals
+    fprintf(out, "#define PUSH_ROOM(d) if (sp == (d)) return fail(\"stack overflow\")\n");
+    fprintf(out, "#define POPS(n) if (sp > STACK_SIZE - (n)) return fail(\"stack underflow\")\n");
+    fprintf(out, "#define CALL(link, ret) if (sp < 3 || calls == MAX_CALLS) return fail(\"stack overflow\"); \\\n"
+                 "    stack[sp - 1] = link; stack[sp - 2] = bp; stack[sp - 3] = ret; bp = sp - 1; calls++\n");
+    fprintf(out, "#define RETURN sp = bp + 1; bp = stack[sp - 2]; pc = stack[sp - 3]; \\\n"
+                 "    if ((unsigned)bp >= STACK_SIZE || (unsigned)pc > CODE_COUNT) \\\n"
+                 "        return fail(\"RTN to an overwritten return address or dynamic link\"); \\\n"
+                 "    if (calls > 0) calls--; \\\n    goto dispatch\n\n");
+    // LOD/STO offsets are below STACK_SIZE (check_instruction()), so the
+    // slack under stack[0] keeps bp - m in bounds, as in the VM
+    fprintf(out, "static int memory[2 * STACK_SIZE]; // variables start at 0, as in PM/0\n");
+    fprintf(out, "static int *const stack = memory + STACK_SIZE;\n\n");
+    fprintf(out, "static int fail(const char *message) {\n    fflush(stdout);\n"
+                 "    fprintf(stderr, \"Error: %%s\\n\", message);\n    return EXIT_FAILURE;\n}\n\n");
+    fprintf(out, "static int base(int bp, int l) {\n    while (l-- > 0) {\n        bp = stack[bp];\n"
+                 "        if ((unsigned)bp >= STACK_SIZE) exit(fail(\"overwritten static link\"));\n"
+                 "    }\n    return bp;\n}\n\n");
+    // opr_div() in parsercodegen.h
+    fprintf(out, "static int divide(int a, int b) {\n    return b == -1 ? (int)(0u - (unsigned)a) : a / b;\n}\n\n");
+    fprintf(out, "static int read_int(void) {\n    int value;\n    if (scanf(\"%%d\", &value) != 1) value = 0;\n    return value;\n}\n\n");
+    fprintf(out, "int main(void) {\n");
+    fprintf(out, "    int sp = STACK_SIZE, bp = sp - 1, pc = %d, calls = 0;\n", count);
+    for (int d = 0; d < max_depth; d++) fprintf(out, "%s s%d", d == 0 ? "    int" : ",", d);
+    if (max_depth > 0) fprintf(out, ";\n");
+    fprintf(out, "    (void)base;\n    (void)divide;\n    (void)read_int;\n    (void)pc;\n    (void)calls;\n");
+    fprintf(out, "    // main's activation record: links to itself, and RTN from it halts\n");
+    fprintf(out, "    stack[bp] = bp;\n    stack[bp - 1] = bp;\n    stack[bp - 2] = %d;\n\n", count);
+
+    for (int i = 0; i < count; i++) {
+        static const char *names[] = {"", "LIT", "OPR", "LOD", "STO", "CAL", "INC", "JMP", "JPC", "SYS", "LLOS", "LLOJ", "LSTO"};
+        if (is_label[i]) fprintf(out, "L%d:\n", i);
+        fprintf(out, "    /* %d %s %d %d */ ", i, names[code[i].op], code[i].l, code[i].m);
+        if (depth) emit_registers(out, &code[i], i, count, depth[i]);
+        else emit_stack(out, &code[i], i, count);
+        fprintf(out, "\n");
+    }
+
+    fprintf(out, "halt:\n    fflush(stdout);\n    return EXIT_SUCCESS;\n");
+    if (has_rtn) {
+        fprintf(out, "dispatch:\n    switch (pc) {\n");
+        for (int i = 0; i < count; i++) {
+            if (is_return[i]) fprintf(out, "        case %d: goto L%d;\n", i, i);
+        }
+        fprintf(out, "        default: goto halt;\n    }\n");
+    }
+    fprintf(out, "}\n");
+
+    free(is_label);
+    free(is_return);
+    free(depth);
+    return 0;
+}
+
+
+#ifndef AOT_LIBRARY
+// 1 if path names the same file as input (which exists)
+static int same_file(const char *path, const struct stat *input) {
+    struct stat st;
+    return stat(path, &st) == 0 && st.st_dev == input->st_dev && st.st_ino == input->st_ino;
+}
+
+
+// run $CC -O2 -o program source; returns its exit status
+static int run_compiler(const char *source, const char *program) {
+    const char *cc = getenv("CC");
+    if (!cc || !*cc) cc = "cc";
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        execlp(cc, cc, "-O2", "-o", program, source, (char *)NULL);
+        perror(cc);
+        _exit(127);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) < 0) return -1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+
+int main(int argc, char *argv[]) {
+    const char *paths[2] = {NULL, NULL};
+    int path_count = 0, build = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cc") == 0) build = 1;
+        else if (path_count < 2) paths[path_count++] = argv[i];
+        else path_count = 3;
+    }
+    if (path_count != 2) {
+        fprintf(stderr, "Usage: %s [--cc] <code file> <out.c | program>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *input = paths[0];
+    const char *output = paths[1];
+
+    instruction *code;
+    int count;
+    if (obj_is_object(input)) {
+        obj_file obj;
+        if (obj_open(input, &obj) < 0) return EXIT_FAILURE;
+        count = obj_read_code(&obj, &code);
+        obj_close(&obj);
+    } else {
+        count = vm_load_text(input, &code);
+    }
+    if (count < 0) return EXIT_FAILURE;
+
+    char *source = malloc(strlen(output) + 3);
+    if (!source) return EXIT_FAILURE;
+    strcpy(source, output);
+    if (build) strcat(source, ".c");
+
+    struct stat in_stat;
+    if (stat(input, &in_stat) == 0 && (same_file(source, &in_stat) || (build && same_file(output, &in_stat)))) {
+        fprintf(stderr, "Error: '%s' is the code file; refusing to write over it.\n",
+                same_file(source, &in_stat) ? source : output);
+        free(code);
+        free(source);
+        return EXIT_FAILURE;
+    }
+
+    FILE *out = fopen(source, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Could not open output file '%s'.\n", source);
+        return EXIT_FAILURE;
+    }
+    int status = aot_write_c(code, count, input, out);
+    if (fclose(out) != 0 && status == 0) {
+        fprintf(stderr, "Error: Could not write '%s'.\n", source);
+        status = -1;
+    }
+    free(code);
+    if (status == 0 && build && run_compiler(source, output) != 0) {
+        fprintf(stderr, "Error: Could not build '%s' from '%s'.\n", output, source);
+        status = -1;
+    }
+    free(source);
+    return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
@@ -0,0 +1,23 @@
+/*
+    aot.h - Ahead-of-time compiler from PM/0 code to C
+
+    Turns code[] into a standalone C program that behaves like ./vm on
+    the same code: same output, same error messages on stderr and the
+    same exit status.
+
+    To Compile (library mode, no main() in aot.c):
+        gcc -O2 -std=c11 -DAOT_LIBRARY -c aot.c
+*/
+
+#ifndef AOT_H
+#define AOT_H
+
+#include <stdio.h>
+#include "parsercodegen.h"
+
+// Write code[0..count) as a C translation unit to out; origin names the
+// code in the generated header comment. Returns 0, or -1 if the code
+// isn't valid PM/0 (nothing is written then)
+int aot_write_c(const instruction *code, int count, const char *origin, FILE *out);
+
+#endif
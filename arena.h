@@ -0,0 +1,109 @@
+/*
+    arena.h - Per-compilation bump allocator
+
+    Backs the growable tables of one compilation (tokens, interned names,
+    code, symbols). Allocation is a pointer bump inside a block; nothing
+    is freed individually. arena_reset() drops everything at once and
+    keeps the memory: if the last compile needed more than one block they
+    are merged into a single block of the combined size, so compiling
+    programs of a similar size again does no malloc at all.
+
+    Header-only, so every program that includes lex.h builds unchanged.
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE ((size_t)1 << 16)  // first block
+#define ARENA_MAX_STEP ((size_t)1 << 24)    // blocks double up to this size
+#define ARENA_ALIGN 16
+
+typedef struct arena_block {
+    struct arena_block *next;   // older block
+    size_t size;                // bytes in data
+    size_t used;
+    max_align_t data[];
+} arena_block;
+
+typedef struct {
+    arena_block *blocks;        // current block first
+    size_t reserved;            // bytes held in all blocks
+    char *last;                 // most recent allocation (grown in place)
+} arena;
+
+static inline void arena_init(arena *a) {
+    a->blocks = NULL;
+    a->reserved = 0;
+    a->last = NULL;
+}
+
+static inline void arena_free(arena *a) {
+    while (a->blocks) {
+        arena_block *next = a->blocks->next;
+        free(a->blocks);
+        a->blocks = next;
+    }
+    arena_init(a);
+}
+
+static inline arena_block *arena_new_block(arena *a, size_t need) {
+    size_t size = a->blocks ? a->blocks->size * 2 : ARENA_BLOCK_SIZE;
+    if (size > ARENA_MAX_STEP) size = ARENA_MAX_STEP;
+    if (size < need) size = need;
+    arena_block *b = malloc(sizeof(arena_block) + size);
+    if (!b) return NULL;
+    b->next = a->blocks;
+    b->size = size;
+    b->used = 0;
+    a->blocks = b;
+    a->reserved += size;
+    return b;
+}
+
+// size bytes aligned to ARENA_ALIGN; NULL when out of memory
+static inline void *arena_alloc(arena *a, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    arena_block *b = a->blocks;
+    if (!b || b->size - b->used < size) {
+        b = arena_new_block(a, size);
+        if (!b) return NULL;
+    }
+    char *p = (char *)b->data + b->used;
+    b->used += size;
+    a->last = p;
+    return p;
+}
+
+// resize old (old_size bytes) to new_size: in place when it is the most
+// recent allocation and the block has room, otherwise copied
+static inline void *arena_grow(arena *a, void *old, size_t old_size, size_t new_size) {
+    arena_block *b = a->blocks;
+    if (old && old == a->last) {
+        size_t start = (size_t)((char *)old - (char *)b->data);
+        size_t size = (new_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+        if (b->size - start >= size) {
+            b->used = start + size;
+            return old;
+        }
+    }
+    void *p = arena_alloc(a, new_size);
+    if (p && old) memcpy(p, old, old_size < new_size ? old_size : new_size);
+    return p;
+}
+
+// forget every allocation; the memory is kept for the next compile
+static inline void arena_reset(arena *a) {
+    if (a->blocks && a->blocks->next) {
+        size_t total = a->reserved;
+        arena_free(a);
+        if (!arena_new_block(a, total)) return; // next arena_alloc tries again
+    }
+    if (a->blocks) a->blocks->used = 0;
+    a->last = NULL;
+}
+
+#endif
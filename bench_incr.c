@@ -0,0 +1,193 @@
+/*
+    bench_incr - Edit-to-code latency of incremental recompilation
+
+    Generates a PL/0 program with one top-level statement per line, then
+    applies random edits (change a number, insert a statement, delete a
+    statement, insert a comment; every 50th edit changes a constant's
+    declaration) with inc_edit() and times each one against a full
+    lexer() + parse_program() compile of the same text. Every edit's code
+    is checked against the full compile.
+
+    To Compile:
+        gcc -O2 -std=c11 -DLEX_LIBRARY -DPARSER_LIBRARY -o bench_incr bench_incr.c incremental.c parsercodegen.c lex.c
+
+    To Execute:
+        ./bench_incr [lines] [edits]
+    where:
+        [lines] defaults to 100000 and [edits] to 200
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "incremental.h"
+
+#define HEADER_LINES 3 // const, var, begin
+
+double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// one statement line, varied by n
+int statement_line(char *out, size_t size, int n)
+{
+    int v = n % 997 + 1;
+    switch (n % 5)
+    {
+        case 0: return snprintf(out, size, "  a := a + %d * b;\n", v);
+        case 1: return snprintf(out, size, "  if a > %d then b := b - 1 fi;\n", v);
+        case 2: return snprintf(out, size, "  while i < %d do i := i + 1;\n", v);
+        case 3: return snprintf(out, size, "  begin c := (a + b) / %d; write c end;\n", v);
+        default: return snprintf(out, size, "  b := b * k - %d;\n", v);
+    }
+}
+
+char *generate(int lines, size_t *len)
+{
+    size_t cap = (size_t)lines * 48 + 64, used = 0;
+    char *text = malloc(cap);
+    if (!text) return NULL;
+    used += snprintf(text, cap, "const k = 7;\nvar a, b, c, i;\nbegin\n");
+    for (int n = 0; n < lines; n++)
+    {
+        used += statement_line(text + used, cap - used, n);
+    }
+    used += snprintf(text + used, cap - used, "  write a\nend.\n");
+    *len = used;
+    return text;
+}
+
+// byte offset of the start of line (0-based) in text
+size_t line_start(const char *text, int line)
+{
+    const char *s = text;
+    for (int i = 0; i < line; i++) s = strchr(s, '\n') + 1;
+    return (size_t)(s - text);
+}
+
+int main(int argc, char *argv[])
+{
+    int lines = argc > 1 ? atoi(argv[1]) : 100000;
+    int edits = argc > 2 ? atoi(argv[2]) : 200;
+    if (lines < 1 || edits < 1)
+    {
+        fprintf(stderr, "Usage: %s [lines] [edits]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size_t len;
+    char *source = generate(lines, &len);
+    if (!source) return EXIT_FAILURE;
+
+    inc_unit unit;
+    lexContext lc;
+    parser_ctx full;
+    inc_init(&unit);
+    lexInit(&lc);
+    parser_init(&full);
+
+    double start = now_seconds();
+    if (inc_compile(&unit, source, len) < 0)
+    {
+        fprintf(stderr, "generated program failed to compile: %s\n", unit.error_msg);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "%d lines, %d tokens, %d instructions; first compile %.1f ms\n",
+            lines + HEADER_LINES + 2, unit.lc.tableIndex, unit.code_count, (now_seconds() - start) * 1e3);
+    free(source);
+
+    double *inc_times = malloc((size_t)edits * sizeof(double));
+    double *full_times = malloc((size_t)edits * sizeof(double));
+    if (!inc_times || !full_times) return EXIT_FAILURE;
+    long long relexed = 0, reparsed = 0, moved = 0;
+    int fallbacks = 0, mismatches = 0, statements = lines;
+    srand(402);
+
+    for (int e = 0; e < edits; e++)
+    {
+        char buf[64];
+        int line = HEADER_LINES + rand() % statements;
+        size_t at = line_start(unit.text, line), removed = 0, inserted;
+        const char *text = buf;
+
+        if (e % 50 == 49)
+        {
+            // the constant's value: the declarations change
+            at = strlen("const k = ");
+            removed = strspn(unit.text + at, "0123456789");
+            inserted = (size_t)snprintf(buf, sizeof(buf), "%d", e % 9 + 1);
+        }
+        else switch (e % 4)
+        {
+            case 0: // a number in the statement
+                at += strcspn(unit.text + at, "0123456789");
+                removed = strspn(unit.text + at, "0123456789");
+                inserted = (size_t)snprintf(buf, sizeof(buf), "%d", rand() % 997 + 1);
+                break;
+            case 1:
+                inserted = (size_t)statement_line(buf, sizeof(buf), rand());
+                statements++;
+                break;
+            case 2:
+                removed = line_start(unit.text + at, 1);
+                inserted = 0;
+                statements--;
+                break;
+            default:
+                text = "/* edited */ ";
+                inserted = strlen(text);
+                break;
+        }
+
+        double t0 = now_seconds();
+        int status = inc_edit(&unit, at, removed, text, inserted);
+        double t1 = now_seconds();
+        lexer(&lc, unit.text);
+        int full_status = parse_program(&full, lc.table, lc.tableIndex);
+        double t2 = now_seconds();
+
+        inc_times[e] = t1 - t0;
+        full_times[e] = t2 - t1;
+        relexed += unit.stats.tokens_relexed;
+        reparsed += unit.stats.statements_reparsed;
+        moved += unit.stats.code_moved;
+        fallbacks += unit.stats.full;
+        if (status != full_status || (status == 0 && (unit.code_count != full.code_index ||
+            memcmp(unit.code, full.code, (size_t)full.code_index * sizeof(instruction)) != 0)))
+        {
+            fprintf(stderr, "edit %d: incremental code differs from a full compile\n", e);
+            mismatches++;
+        }
+    }
+
+    qsort(inc_times, edits, sizeof(double), compare_doubles);
+    qsort(full_times, edits, sizeof(double), compare_doubles);
+    double inc_median = inc_times[edits / 2], full_median = full_times[edits / 2];
+    fprintf(stderr, "%d edits (%d full recompiles), code identical to a full compile: %s\n",
+            edits, fallbacks, mismatches ? "NO" : "yes");
+    fprintf(stderr, "  incremental  median %8.3f ms, p90 %8.3f ms, max %8.3f ms\n",
+            inc_median * 1e3, inc_times[edits * 9 / 10] * 1e3, inc_times[edits - 1] * 1e3);
+    fprintf(stderr, "  full         median %8.3f ms, p90 %8.3f ms, max %8.3f ms\n",
+            full_median * 1e3, full_times[edits * 9 / 10] * 1e3, full_times[edits - 1] * 1e3);
+    fprintf(stderr, "  %.0fx faster at the median; per edit %.1f tokens re-lexed, %.1f statements re-parsed, %.0f instructions moved\n",
+            full_median / inc_median, (double)relexed / edits, (double)reparsed / edits, (double)moved / edits);
+
+    free(inc_times);
+    free(full_times);
+    parser_free(&full);
+    lexFree(&lc);
+    inc_free(&unit);
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+/*
+    bench_lex - Lexer throughput benchmark for PL/0
+
+    Builds a large synthetic PL/0 source in memory and times lexer() over
+    it, reporting tokens/second and MB/second (best of several runs).
+    Set PL0_SIMD=scalar|sse2|avx2 to compare the run scanners.
+
+    To Compile:
+        After (char-class table + perfect-hash keywords):
+            gcc -O2 -std=c11 -DLEX_LIBRARY -o bench_lex bench_lex.c lex.c
+        Before (libc ctype + linear keyword search):
+            gcc -O2 -std=c11 -DLEX_LIBRARY -DLEX_CTYPE_CLASSIFY -o bench_lex_ctype bench_lex.c lex.c
+
+    To Execute:
+        ./bench_lex [megabytes] [runs] [banner]
+    where:
+        banner (0/1) indents every statement deeply and puts a large
+        comment banner before it, like generated sources do
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lex.h"
+
+// Statement shapes mixed into the synthetic program
+const char *snippets[] = 
+{
+    "    counter%d := counter%d + 1;\n",
+    "    while index%d < limit do index%d := index%d * 2;\n",
+    "    if odd value%d then write value%d fi;\n",
+    "    /* update accumulator %d */ acc := acc - (x%d / 3);\n",
+    "    read input%d; write input%d + 12345;\n",
+    "    begin a%d := b%d; c := d <> e end;\n"
+};
+
+double now_seconds() 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// build roughly `bytes` of PL/0 source
+char *make_source(size_t bytes, int banner, size_t *out_len) 
+{
+    int n = sizeof(snippets) / sizeof(snippets[0]);
+    char *buf = malloc(bytes + 1024);
+    size_t len = 0;
+    len += sprintf(buf, "const limit = 100;\nvar acc, c, d, e;\nbegin\n");
+    for (int i = 0; len < bytes; i++) 
+    {
+        int id = i % 1000;
+        if (banner) 
+        {
+            // "/****...\n * generated block N\n ****...*/" then deep indentation
+            len += sprintf(buf + len, "    /*");
+            memset(buf + len, '*', 200); len += 200;
+            len += sprintf(buf + len, "\n     * generated block %d\n     ", id);
+            memset(buf + len, '*', 200); len += 200;
+            len += sprintf(buf + len, "*/\n");
+            memset(buf + len, ' ', 48); len += 48;
+        }
+        len += sprintf(buf + len, snippets[i % n], id, id, id);
+    }
+    len += sprintf(buf + len, "end.\n");
+    *out_len = len;
+    return buf;
+}
+
+int main(int argc, char *argv[]) 
+{
+    size_t megabytes = argc > 1 ? (size_t)atoi(argv[1]) : 16;
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+    int banner = argc > 3 ? atoi(argv[3]) : 0;
+
+    size_t len;
+    char *src = make_source(megabytes << 20, banner, &len);
+
+    lexContext lc;
+    lexInit(&lc);
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) 
+    {
+        double start = now_seconds();
+        lexer(&lc, src);
+        double elapsed = now_seconds() - start;
+        if (elapsed < best) best = elapsed;
+    }
+
+#ifdef LEX_CTYPE_CLASSIFY
+    const char *mode = "ctype + linear keywords";
+#else
+    const char *mode = "char table + perfect hash";
+#endif
+    printf("%s (%s scanners): %zu bytes, %d tokens, best %.3f s\n", mode, lexScanner, len, lc.tableIndex, best);
+    printf("  %.2f Mtokens/s, %.1f MB/s\n", lc.tableIndex / best / 1e6, len / best / (1 << 20));
+
+    lexFree(&lc);
+    free(src);
+    return 0;
+}
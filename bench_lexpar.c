@@ -0,0 +1,130 @@
+/*
+    bench_lexpar - Parallel lexer scaling benchmark for PL/0
+
+    Builds a large synthetic PL/0 source in memory, times lexer() over it
+    and then lexerParallel() on 1..N threads (best of several runs), and
+    checks that every parallel result is identical to lexer()'s: the
+    same tokens with the same positions and identifier IDs.
+
+    To Compile:
+        gcc -O2 -std=c11 -pthread -DLEX_LIBRARY -DLEXPAR_LIBRARY -o bench_lexpar bench_lexpar.c lexpar.c lex.c
+
+    To Execute:
+        ./bench_lexpar [megabytes] [max threads] [runs]
+    where:
+        [max threads] defaults to the number of online CPUs
+    Notes:
+    - Every fourth statement has a multi-line comment in front of it, so
+      chunk cuts regularly land inside comments.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "lexpar.h"
+
+// Statement shapes mixed into the synthetic program
+const char *snippets[] =
+{
+    "    counter%d := counter%d + 1;\n",
+    "    while index%d < limit do index%d := index%d * 2;\n",
+    "    if odd value%d then write value%d fi;\n",
+    "    /* update accumulator %d */ acc := acc - (x%d / 3);\n",
+    "    read input%d; write input%d + 12345;\n",
+    "    begin a%d := b%d; c := d <> e end;\n"
+};
+
+double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// build roughly `bytes` of PL/0 source
+char *make_source(size_t bytes, size_t *out_len)
+{
+    int n = sizeof(snippets) / sizeof(snippets[0]);
+    char *buf = malloc(bytes + 1024);
+    size_t len = 0;
+    len += sprintf(buf, "const limit = 100;\nvar acc, c, d, e;\nbegin\n");
+    for (int i = 0; len < bytes; i++)
+    {
+        int id = i % 5000;
+        if (i % 4 == 0)
+        {
+            len += sprintf(buf + len, "    /* block %d:\n       x := y * z; begin end\n    */\n", id);
+        }
+        len += sprintf(buf + len, snippets[i % n], id, id, id);
+    }
+    len += sprintf(buf + len, "end.\n");
+    *out_len = len;
+    return buf;
+}
+
+// same tokens, positions and identifiers
+int same_tokens(const lexContext *a, const lexContext *b)
+{
+    if (a->tableIndex != b->tableIndex || a->identCount != b->identCount) return 0;
+    if (memcmp(a->table, b->table, (size_t)a->tableIndex * sizeof(lexeme)) != 0) return 0;
+    for (int id = 0; id < a->identCount; id++)
+    {
+        if (strcmp(identName(a, id), identName(b, id)) != 0) return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t megabytes = argc > 1 ? (size_t)atoi(argv[1]) : 64;
+    int max_threads = argc > 2 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int runs = argc > 3 ? atoi(argv[3]) : 5;
+    if (max_threads < 1) max_threads = 1;
+
+    size_t len;
+    char *src = make_source(megabytes << 20, &len);
+
+    lexContext seq, par;
+    lexInit(&seq);
+    lexInit(&par);
+    double base = 1e30;
+    for (int r = 0; r < runs; r++)
+    {
+        double start = now_seconds();
+        lexer(&seq, src);
+        double elapsed = now_seconds() - start;
+        if (elapsed < base) base = elapsed;
+    }
+    printf("lexer() (%s scanners): %zu bytes, %d tokens, best %.3f s (%.1f MB/s)\n",
+           lexScanner, len, seq.tableIndex, base, len / base / (1 << 20));
+
+    int failed = 0;
+    for (int t = 1; t <= max_threads; t++)
+    {
+        lexParallel lp;
+        lexParallelInit(&lp, t);
+        double best = 1e30;
+        for (int r = 0; r < runs; r++)
+        {
+            double start = now_seconds();
+            lexerParallel(&lp, &par, src);
+            double elapsed = now_seconds() - start;
+            if (elapsed < best) best = elapsed;
+        }
+        int same = same_tokens(&seq, &par);
+        failed |= !same;
+        printf("  %2d threads (%2d chunks): best %.3f s (%.1f MB/s), %.2fx lexer()%s\n",
+               t, lp.chunksUsed, best, len / best / (1 << 20), base / best,
+               same ? "" : "  MISMATCH");
+        lexParallelFree(&lp);
+    }
+
+    lexFree(&seq);
+    lexFree(&par);
+    free(src);
+    return failed;
+}
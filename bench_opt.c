@@ -0,0 +1,113 @@
+/*
+    bench_opt - Optimizer benchmark for PL/0
+
+    Compiles each source in-process, then runs the plain and the
+    optimize_code() version on the VM and reports the static instruction
+    count, the instructions executed, and the median run time of each.
+
+    To Compile:
+        gcc -O2 -std=c11 -DLEX_LIBRARY -DPARSER_LIBRARY -DVM_LIBRARY -DOBJECT_LIBRARY -o bench_opt bench_opt.c parsercodegen.c lex.c optimizer.c vm.c jit.c object.c
+
+    To Execute:
+        ./bench_opt [runs] bench_fold.txt bench_loop.txt input5_updated.txt > /dev/null < /dev/null
+    where:
+        program output goes to stdout (read gets 0 at EOF); the report is
+        printed to stderr
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lex.h"
+#include "optimizer.h"
+#include "vm.h"
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// median wall time of `runs` VM runs, or -1 if the code fails to run
+double median_time(const instruction *code, int count, int runs, long long *executed)
+{
+    double *times = malloc((size_t)runs * sizeof(double));
+    vm_stats stats;
+    for (int r = 0; r < runs; r++)
+    {
+        if (vm_run(code, count, &stats) != VM_OK)
+        {
+            free(times);
+            return -1;
+        }
+        times[r] = stats.seconds;
+        *executed = stats.instructions;
+    }
+    qsort(times, runs, sizeof(double), compare_doubles);
+    double median = times[runs / 2];
+    free(times);
+    return median;
+}
+
+void bench_file(parser_ctx *p, lexContext *lc, const char *path, int runs)
+{
+    if (lexFile(lc, path) < 0)
+    {
+        fprintf(stderr, "%s: could not read source\n", path);
+        return;
+    }
+    if (parse_program(p, lc->table, lc->tableIndex) < 0)
+    {
+        fprintf(stderr, "%s: %s\n", path, p->error_msg ? p->error_msg : "Error: Scanning error detected by lexer");
+        return;
+    }
+
+    int plain_count = p->code_index;
+    instruction *plain = p->code;
+    instruction *optimized = malloc((size_t)plain_count * sizeof(instruction));
+    if (!optimized) return;
+    memcpy(optimized, p->code, (size_t)plain_count * sizeof(instruction));
+    opt_stats stats;
+    int optimized_count = optimize_code(optimized, plain_count, &stats);
+
+    long long plain_executed = 0, optimized_executed = 0;
+    double plain_time = median_time(plain, plain_count, runs, &plain_executed);
+    double optimized_time = median_time(optimized, optimized_count, runs, &optimized_executed);
+    free(optimized);
+
+    fprintf(stderr, "%s\n", path);
+    fprintf(stderr, "  code      %6d -> %6d instructions (%d folded, %d identities, %d branches, %d dead)\n",
+            plain_count, optimized_count, stats.folded, stats.identities, stats.branches, stats.dead);
+    if (plain_time < 0 || optimized_time < 0)
+    {
+        fprintf(stderr, "  run       stopped with a VM error\n");
+        return;
+    }
+    fprintf(stderr, "  executed  %6lld -> %6lld instructions (%.1f%% fewer)\n",
+            plain_executed, optimized_executed,
+            plain_executed ? 100.0 * (plain_executed - optimized_executed) / plain_executed : 0.0);
+    fprintf(stderr, "  time      %.4f s -> %.4f s\n", plain_time, optimized_time);
+}
+
+int main(int argc, char *argv[])
+{
+    int first = 1, runs = 5;
+    if (argc > 1 && atoi(argv[1]) > 0)
+    {
+        runs = atoi(argv[1]);
+        first = 2;
+    }
+    if (first >= argc)
+    {
+        fprintf(stderr, "Usage: %s [runs] <source.txt>...\n", argv[0]);
+        return 1;
+    }
+    parser_ctx p;
+    lexContext lc;
+    parser_init(&p);
+    lexInit(&lc);
+    for (int i = first; i < argc; i++) bench_file(&p, &lc, argv[i], runs);
+    parser_free(&p);
+    lexFree(&lc);
+    return 0;
+}
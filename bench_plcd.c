@@ -0,0 +1,306 @@
+/*
+    bench_plcd - Load generator for the plcd compile daemon
+
+    Opens one connection per client thread to a running ./plcd and sends
+    compile requests back to back (each client waits for its reply
+    before sending the next), cycling through the given sources. Reports
+    requests/second and the p50/p90/p99/max request latency.
+
+    To Compile:
+        gcc -O2 -std=c11 -pthread -o bench_plcd bench_plcd.c
+
+    To Execute:
+        ./plcd /tmp/plcd.sock &
+        ./bench_plcd /tmp/plcd.sock [-c clients] [-n requests] [--optimize] [--fuse] [--all-errors] <source.txt>...
+    where:
+        -c is the number of concurrent clients (default 4)
+        -n is the number of requests per client (default 10000)
+    Notes:
+    - Every source is compiled once before the timed run; its reply is
+      kept, and every later reply for it must be byte-for-byte the same
+      (counted as mismatches otherwise).
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "plcd.h"
+
+// One source and the reply it is expected to get
+typedef struct
+{
+    const char *path;
+    char *text;
+    size_t size;
+    char *reply;           // plcd_reply and its payload
+    size_t reply_size;
+    int ok;                // compiled without errors
+} source;
+
+typedef struct
+{
+    pthread_t thread;
+    int id;
+    double *latency;       // seconds, one per request
+    int done;
+    int mismatches;
+    int failed;            // lost the connection
+} client;
+
+const char *socket_path;
+source *sources;
+int source_count;
+uint32_t flags = 0;
+int requests_per_client = 10000;
+
+double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+char *read_file(const char *path, size_t *size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        perror(path);
+        return NULL;
+    }
+    size_t len = 0, cap = 65536, n;
+    char *text = malloc(cap);
+    while (text && (n = fread(text + len, 1, cap - len, fp)) > 0)
+    {
+        len += n;
+        if (len == cap)
+        {
+            char *grown = realloc(text, cap *= 2);
+            if (!grown) free(text);
+            text = grown;
+        }
+    }
+    fclose(fp);
+    *size = len;
+    return text;
+}
+
+int connect_daemon()
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror(socket_path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int read_full(int fd, void *buf, size_t size)
+{
+    size_t got = 0;
+    while (got < size)
+    {
+        ssize_t n = read(fd, (char *)buf + got, size - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        got += (size_t)n;
+    }
+    return 0;
+}
+
+int write_full(int fd, const void *buf, size_t size)
+{
+    size_t put = 0;
+    while (put < size)
+    {
+        ssize_t n = write(fd, (const char *)buf + put, size - put);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        put += (size_t)n;
+    }
+    return 0;
+}
+
+// send src and read its reply into *buf (grown as needed); returns the
+// reply size or -1
+long compile_remote(int fd, const source *src, char **buf, size_t *cap)
+{
+    plcd_request req = {PLCD_MAGIC, flags, (uint32_t)src->size};
+    struct iovec iov[2] = {{&req, sizeof(req)}, {src->text, src->size}};
+    ssize_t n = writev(fd, iov, 2);
+    if (n < 0) return -1;
+    if ((size_t)n < sizeof(req) + src->size)
+    {
+        // finish a short write the simple way
+        size_t sent = (size_t)n;
+        if (sent < sizeof(req) && write_full(fd, (char *)&req + sent, sizeof(req) - sent) < 0) return -1;
+        size_t from = sent > sizeof(req) ? sent - sizeof(req) : 0;
+        if (write_full(fd, src->text + from, src->size - from) < 0) return -1;
+    }
+
+    plcd_reply reply;
+    if (read_full(fd, &reply, sizeof(reply)) < 0 || reply.magic != PLCD_MAGIC) return -1;
+    size_t size = sizeof(reply) + reply.code_count * sizeof(uint32_t) + reply.pool_count * sizeof(int32_t) + reply.text_size;
+    if (size > *cap)
+    {
+        char *grown = realloc(*buf, size);
+        if (!grown) return -1;
+        *buf = grown;
+        *cap = size;
+    }
+    memcpy(*buf, &reply, sizeof(reply));
+    if (read_full(fd, *buf + sizeof(reply), size - sizeof(reply)) < 0) return -1;
+    return (long)size;
+}
+
+void *client_main(void *arg)
+{
+    client *c = arg;
+    int fd = connect_daemon();
+    if (fd < 0)
+    {
+        c->failed = 1;
+        return NULL;
+    }
+    char *buf = NULL;
+    size_t cap = 0;
+    for (int i = 0; i < requests_per_client; i++)
+    {
+        const source *src = &sources[(c->id + i) % source_count];
+        double start = now_seconds();
+        long size = compile_remote(fd, src, &buf, &cap);
+        c->latency[i] = now_seconds() - start;
+        if (size < 0)
+        {
+            c->failed = 1;
+            break;
+        }
+        if ((size_t)size != src->reply_size || memcmp(buf, src->reply, src->reply_size) != 0) c->mismatches++;
+        c->done++;
+    }
+    free(buf);
+    close(fd);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    int client_count = 4;
+    sources = calloc((size_t)argc, sizeof(source));
+    if (!sources) return 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) client_count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) requests_per_client = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--optimize") == 0) flags |= PLCD_OPTIMIZE;
+        else if (strcmp(argv[i], "--fuse") == 0) flags |= PLCD_FUSE;
+        else if (strcmp(argv[i], "--all-errors") == 0) flags |= PLCD_ALL_ERRORS;
+        else if (!socket_path) socket_path = argv[i];
+        else sources[source_count++].path = argv[i];
+    }
+    if (!socket_path || source_count == 0 || client_count < 1 || requests_per_client < 1)
+    {
+        fprintf(stderr, "Usage: %s <socket> [-c clients] [-n requests] [--optimize] [--fuse] [--all-errors] <source.txt>...\n", argv[0]);
+        return 1;
+    }
+
+    // one untimed compile of every source gives the expected replies
+    int fd = connect_daemon();
+    if (fd < 0) return 1;
+    int failing = 0;
+    for (int i = 0; i < source_count; i++)
+    {
+        source *src = &sources[i];
+        src->text = read_file(src->path, &src->size);
+        if (!src->text) return 1;
+        size_t cap = 0;
+        long size = compile_remote(fd, src, &src->reply, &cap);
+        if (size < 0)
+        {
+            fprintf(stderr, "Error: no reply for %s\n", src->path);
+            return 1;
+        }
+        src->reply_size = (size_t)size;
+        src->ok = ((plcd_reply *)src->reply)->status == PLCD_OK;
+        failing += !src->ok;
+    }
+    close(fd);
+
+    client *clients = calloc((size_t)client_count, sizeof(client));
+    if (!clients) return 1;
+    for (int i = 0; i < client_count; i++)
+    {
+        clients[i].id = i;
+        clients[i].latency = malloc((size_t)requests_per_client * sizeof(double));
+        if (!clients[i].latency) return 1;
+    }
+    double start = now_seconds();
+    for (int i = 0; i < client_count; i++)
+    {
+        if (pthread_create(&clients[i].thread, NULL, client_main, &clients[i]) != 0)
+        {
+            fprintf(stderr, "Error: could not start client %d\n", i);
+            return 1;
+        }
+    }
+    for (int i = 0; i < client_count; i++) pthread_join(clients[i].thread, NULL);
+    double elapsed = now_seconds() - start;
+
+    long total = 0, mismatches = 0, lost = 0;
+    for (int i = 0; i < client_count; i++)
+    {
+        total += clients[i].done;
+        mismatches += clients[i].mismatches;
+        lost += clients[i].failed;
+    }
+    double *all = malloc((size_t)(total + 1) * sizeof(double));
+    if (!all) return 1;
+    long k = 0;
+    for (int i = 0; i < client_count; i++)
+    {
+        memcpy(all + k, clients[i].latency, (size_t)clients[i].done * sizeof(double));
+        k += clients[i].done;
+    }
+    qsort(all, (size_t)total, sizeof(double), compare_doubles);
+
+    printf("%d sources (%d with errors), %d clients x %d requests\n", source_count, failing, client_count, requests_per_client);
+    printf("  %ld requests in %.3f s: %.0f requests/s\n", total, elapsed, total / elapsed);
+    if (total > 0)
+    {
+        printf("  latency p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+               all[total / 2] * 1e6, all[total * 90 / 100] * 1e6, all[total * 99 / 100] * 1e6, all[total - 1] * 1e6);
+    }
+    if (mismatches || lost) printf("  %ld replies differed from the first one, %ld clients lost their connection\n", mismatches, lost);
+
+    for (int i = 0; i < source_count; i++)
+    {
+        free(sources[i].text);
+        free(sources[i].reply);
+    }
+    for (int i = 0; i < client_count; i++) free(clients[i].latency);
+    free(clients);
+    free(sources);
+    free(all);
+    return mismatches || lost ? 1 : 0;
+}
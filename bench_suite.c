@@ -0,0 +1,179 @@
+/*
+    bench_suite - Reproducible performance suite for the PL/0 pipeline
+
+    Runs every stage of lex + parsercodegen (and optionally the VM or the
+    JIT) in-process over a corpus several times and reports, per stage,
+    the median time of a pass over the whole corpus, its throughput in
+    MB/s of source and tokens/s, and the spread across runs (standard
+    deviation, coefficient of variation, min and max).
+
+    Stages, each timed over all files:
+        lex      lexFile() (file read + lexer())
+        parse    parse_program() on the token table
+        write    write_code_to_file() into /dev/null
+        vm       vm_run() of the code (--vm)
+        jit      jit_run() of the code (--jit)
+
+    To Compile:
+        gcc -O2 -std=c11 -DLEX_LIBRARY -DPARSER_LIBRARY -DVM_LIBRARY -DOBJECT_LIBRARY -o bench_suite bench_suite.c parsercodegen.c lex.c vm.c jit.c object.c -lm
+
+    To Execute:
+        ./gen_corpus -s 262144 -n 16 -o corpus
+        ./bench_suite [-r runs] [--vm] [--jit] corpus/p*.txt > /dev/null < /dev/null
+    where:
+        -r defaults to 7 runs; program output (write) goes to stdout and
+        the report to stderr
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "lex.h"
+#include "vm.h"
+#include "jit.h"
+
+enum { LEX, PARSE, WRITE, VM, JIT, STAGES };
+const char *stage_names[STAGES] = {"lex", "parse", "write", "vm", "jit"};
+
+double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// one line of the report for a stage timed over `runs` passes; the
+// compiler stages report bytes and tokens, the VM stages instructions
+void report(const char *name, double *times, int runs, double bytes, double tokens, long long instructions)
+{
+    double mean = 0, variance = 0;
+    for (int r = 0; r < runs; r++) mean += times[r];
+    mean /= runs;
+    for (int r = 0; r < runs; r++) variance += (times[r] - mean) * (times[r] - mean);
+    double stddev = runs > 1 ? sqrt(variance / (runs - 1)) : 0;
+
+    qsort(times, runs, sizeof(double), compare_doubles);
+    double median = times[runs / 2];
+    fprintf(stderr, "  %-6s %10.3f ms", name, median * 1e3);
+    if (bytes > 0) fprintf(stderr, "  %9.2f MB/s  %8.2f Mtokens/s", bytes / median / 1e6, tokens / median / 1e6);
+    else if (instructions) fprintf(stderr, "  %9.1f M instr/s %17s", instructions / median / 1e6, "");
+    else fprintf(stderr, "  %38s", "");
+    fprintf(stderr, "   sd %.3f ms (cv %.1f%%), min %.3f, max %.3f\n", stddev * 1e3,
+            mean > 0 ? 100 * stddev / mean : 0, times[0] * 1e3, times[runs - 1] * 1e3);
+}
+
+int main(int argc, char *argv[])
+{
+    int runs = 7, stage_on[STAGES] = {1, 1, 1, 0, 0};
+    const char **files = malloc((size_t)argc * sizeof(char *));
+    int file_count = 0;
+    if (!files) return EXIT_FAILURE;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) runs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--vm") == 0) stage_on[VM] = 1;
+        else if (strcmp(argv[i], "--jit") == 0) stage_on[JIT] = 1;
+        else files[file_count++] = argv[i];
+    }
+    if (file_count == 0 || runs < 1)
+    {
+        fprintf(stderr, "Usage: %s [-r runs] [--vm] [--jit] <source.txt>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    double bytes = 0;
+    for (int f = 0; f < file_count; f++)
+    {
+        struct stat st;
+        if (stat(files[f], &st) < 0)
+        {
+            perror(files[f]);
+            return EXIT_FAILURE;
+        }
+        bytes += (double)st.st_size;
+    }
+
+    FILE *sink = fopen("/dev/null", "w");
+    double *times[STAGES];
+    for (int s = 0; s < STAGES; s++) times[s] = calloc((size_t)runs, sizeof(double));
+    if (!sink || !times[STAGES - 1]) return EXIT_FAILURE;
+
+    lexContext lc;
+    parser_ctx p;
+    lexInit(&lc);
+    parser_init(&p);
+    long long tokens = 0, instructions[STAGES] = {0};
+    int failed = 0;
+
+    for (int r = 0; r < runs; r++)
+    {
+        long long run_tokens = 0, executed[STAGES] = {0};
+        for (int f = 0; f < file_count; f++)
+        {
+            double t0 = now_seconds();
+            if (lexFile(&lc, files[f]) < 0) return EXIT_FAILURE;
+            double t1 = now_seconds();
+            int status = parse_program(&p, lc.table, lc.tableIndex);
+            double t2 = now_seconds();
+            times[LEX][r] += t1 - t0;
+            times[PARSE][r] += t2 - t1;
+            run_tokens += lc.tableIndex;
+            if (status < 0)
+            {
+                if (r == 0)
+                {
+                    fprintf(stderr, "%s: %s\n", files[f], p.error_msg ? p.error_msg : error_message(1));
+                    failed++;
+                }
+                continue;
+            }
+
+            t0 = now_seconds();
+            write_code_to_file(&p, sink);
+            fflush(sink);
+            times[WRITE][r] += now_seconds() - t0;
+
+            vm_stats stats;
+            for (int s = VM; s <= JIT; s++)
+            {
+                if (!stage_on[s]) continue;
+                if ((s == VM ? vm_run : jit_run)(p.code, p.code_index, &stats) != VM_OK)
+                {
+                    if (r == 0) fprintf(stderr, "%s: %s failed\n", files[f], stage_names[s]);
+                    continue;
+                }
+                times[s][r] += stats.seconds;
+                executed[s] += stats.instructions;
+            }
+        }
+        tokens = run_tokens;
+        for (int s = VM; s <= JIT; s++) instructions[s] = executed[s];
+    }
+
+    fprintf(stderr, "%d files (%d failed), %.2f MB, %lld tokens, %d runs; median pass over the corpus:\n",
+            file_count, failed, bytes / 1e6, tokens, runs);
+    for (int s = 0; s < STAGES; s++)
+    {
+        if (!stage_on[s]) continue;
+        if (s < VM) report(stage_names[s], times[s], runs, bytes, (double)tokens, 0);
+        else report(stage_names[s], times[s], runs, 0, 0, instructions[s] ? instructions[s] : instructions[VM]);
+    }
+
+    for (int s = 0; s < STAGES; s++) free(times[s]);
+    parser_free(&p);
+    lexFree(&lc);
+    fclose(sink);
+    free(files);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
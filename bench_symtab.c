@@ -0,0 +1,114 @@
+/*
+    bench_symtab - Symbol table scaling benchmark for PL/0
+
+    Declares N variables and looks each one up several times through
+    add_symbol()/find_symbol(), then compiles a generated program with N
+    declarations end to end. Time per declaration should stay flat as N
+    grows (the old linear scan made declaring N names O(N^2)).
+
+    To Compile:
+        gcc -O2 -std=c11 -DLEX_LIBRARY -DPARSER_LIBRARY -o bench_symtab bench_symtab.c parsercodegen.c lex.c
+
+    To Execute:
+        ./bench_symtab [max declarations]
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "parsercodegen.h"
+
+#define LOOKUPS_PER_SYMBOL 8
+
+parser_ctx ctx;
+
+double now_seconds() 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// symbol table alone: declare n names in an outer scope, shadow half of
+// them in an inner scope, look everything up, then pop the inner scope
+void bench_table(int n, const int *ids) 
+{
+    ctx.sym_index = 0;
+    double start = now_seconds();
+
+    int outer = enter_scope(&ctx);
+    for (int i = 0; i < n; i++) add_symbol(&ctx, VARIABLE, ids[i], 0, 0, 3 + i);
+    int inner = enter_scope(&ctx);
+    for (int i = 0; i < n; i += 2) add_symbol(&ctx, VARIABLE, ids[i], 0, 1, 3 + i);
+    double declared = now_seconds();
+
+    long found = 0;
+    for (int r = 0; r < LOOKUPS_PER_SYMBOL; r++) 
+    {
+        for (int i = 0; i < n; i++) found += find_symbol(&ctx, ids[i]) >= 0;
+    }
+    double looked_up = now_seconds();
+
+    exit_scope(&ctx, inner);
+    exit_scope(&ctx, outer);
+    double done = now_seconds();
+
+    printf("%8d decls: declare %7.1f ns/decl, lookup %6.1f ns/lookup, scope exit %6.1f ns/sym (%ld found)\n",
+           n, (declared - start) * 1e9 / (n + n / 2),
+           (looked_up - declared) * 1e9 / ((double)n * LOOKUPS_PER_SYMBOL),
+           (done - looked_up) * 1e9 / (n + n / 2), found);
+}
+
+// whole pipeline: "var v0, ..., v{n-1}; begin v0 := v{n-1} + 1; ... end."
+void bench_compile(int n) 
+{
+    size_t cap = (size_t)n * 12 + 4096;
+    char *src = malloc(cap);
+    size_t len = sprintf(src, "var ");
+    for (int i = 0; i < n; i++) len += sprintf(src + len, "%sv%d", i ? ", " : "", i);
+    len += sprintf(src + len, ";\nbegin\n");
+    for (int i = 0; i < 200; i++) 
+    {
+        len += sprintf(src + len, "  v%d := v%d + 1;\n", (i * 7919) % n, (i * 104729) % n);
+    }
+    len += sprintf(src + len, "  v0 := 0\nend.\n");
+
+    lexContext lc;
+    lexInit(&lc);
+    double start = now_seconds();
+    lexer(&lc, src);
+    parse_program(&ctx, lc.table, lc.tableIndex);
+    double elapsed = now_seconds() - start;
+
+    printf("%8d decls: compile %8.3f ms (%6.1f ns/decl), %d instructions\n",
+           n, elapsed * 1e3, elapsed * 1e9 / n, ctx.code_index);
+    lexFree(&lc);
+    free(src);
+}
+
+int main(int argc, char *argv[]) 
+{
+    int max = argc > 1 ? atoi(argv[1]) : 100000;
+
+    lexContext names;
+    lexInit(&names);
+    parser_init(&ctx);
+    int *ids = malloc((size_t)max * sizeof(int));
+    for (int i = 0; i < max; i++) 
+    {
+        char name[MAX_ID_LEN + 1];
+        int len = sprintf(name, "s%d", i);
+        ids[i] = internIdent(&names, name, len);
+    }
+
+    for (int n = 1000; n <= max; n *= 10) bench_table(n, ids);
+    for (int n = 1000; n <= max; n *= 10) bench_compile(n);
+
+    free(ids);
+    parser_free(&ctx);
+    lexFree(&names);
+    return 0;
+}
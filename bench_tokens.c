@@ -0,0 +1,159 @@
+/*
+    bench_tokens - tokens.txt reader benchmark for PL/0
+
+    Writes a synthetic tokens.txt of about a million tokens (lexer() +
+    printTokenList() over a generated program), then times
+    read_token_file() (mmap, one pass) against the fscanf() reader it
+    replaced, best of several runs, and checks that both read the same
+    tokens and identifiers.
+
+    To Compile:
+        gcc -O2 -std=c11 -DLEX_LIBRARY -DPARSER_LIBRARY -o bench_tokens bench_tokens.c parsercodegen.c lex.c
+
+    To Execute:
+        ./bench_tokens [tokens] [runs]
+    where:
+        [tokens] defaults to 1000000; the file is written to
+        bench_tokens.txt in the current directory and removed afterwards
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "parsercodegen.h"
+
+#define TOKEN_FILE "bench_tokens.txt"
+
+// Statement shapes mixed into the synthetic program
+const char *snippets[] =
+{
+    "    counter%d := counter%d + 1;\n",
+    "    while index%d < limit do index%d := index%d * 2;\n",
+    "    if odd value%d then write value%d fi;\n",
+    "    read input%d; write input%d + 12345;\n",
+    "    begin a%d := b%d; c := d <> e end;\n"
+};
+
+double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// the fscanf() reader read_token_file() replaced, kept for comparison
+int read_tokens_fscanf(lexContext *lc, const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    lexReset(lc);
+    int token_id;
+    while (fscanf(fp, "%d", &token_id) == 1)
+    {
+        lexeme *tok = newLexeme(lc);
+        tok->token = token_id;
+        if (token_id == identsym)
+        {
+            char name[12];
+            if (fscanf(fp, "%11s", name) != 1)
+            {
+                lc->tableIndex--;
+                break;
+            }
+            tok->value = internIdent(lc, name, (int)strlen(name));
+        }
+        else if (token_id == numbersym)
+        {
+            if (fscanf(fp, "%d", &tok->value) != 1)
+            {
+                lc->tableIndex--;
+                break;
+            }
+        }
+    }
+    fclose(fp);
+    return lc->tableIndex;
+}
+
+// generate a program of at least `tokens` tokens and write its tokens.txt
+int write_token_file(int tokens)
+{
+    int n = sizeof(snippets) / sizeof(snippets[0]);
+    size_t cap = (size_t)tokens * 8 + 4096, len = 0;
+    char *src = malloc(cap);
+    if (!src) return -1;
+    len += sprintf(src, "const limit = 100;\nvar acc, c, d, e;\nbegin\n");
+    lexContext lc;
+    lexInit(&lc);
+    for (int i = 0; len + 128 < cap && (size_t)i * 9 < (size_t)tokens + 16; i++)
+    {
+        int id = i % 1000;
+        len += sprintf(src + len, snippets[i % n], id, id, id);
+    }
+    sprintf(src + len, "end.\n");
+    lexer(&lc, src);
+
+    FILE *fp = fopen(TOKEN_FILE, "w");
+    if (!fp)
+    {
+        perror(TOKEN_FILE);
+        return -1;
+    }
+    printTokenList(fp, &lc);
+    fclose(fp);
+    int count = lc.tableIndex;
+    lexFree(&lc);
+    free(src);
+    return count;
+}
+
+double best_time(int (*reader)(lexContext *, const char *), lexContext *lc, int runs)
+{
+    double best = 1e30;
+    for (int r = 0; r < runs; r++)
+    {
+        double start = now_seconds();
+        reader(lc, TOKEN_FILE);
+        double elapsed = now_seconds() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    int tokens = argc > 1 ? atoi(argv[1]) : 1000000;
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+
+    int written = write_token_file(tokens);
+    if (written < 0) return 1;
+
+    lexContext before, after;
+    lexInit(&before);
+    lexInit(&after);
+    double t_before = best_time(read_tokens_fscanf, &before, runs);
+    double t_after = best_time(read_token_file, &after, runs);
+
+    int same = before.tableIndex == after.tableIndex && before.identCount == after.identCount;
+    for (int i = 0; same && i < before.tableIndex; i++)
+    {
+        same = before.table[i].token == after.table[i].token && before.table[i].value == after.table[i].value;
+    }
+    for (int id = 0; same && id < before.identCount; id++)
+    {
+        same = strcmp(identName(&before, id), identName(&after, id)) == 0;
+    }
+
+    printf("%s: %d tokens, %d identifiers\n", TOKEN_FILE, after.tableIndex, after.identCount);
+    printf("  fscanf()          best %.3f s (%.2f Mtokens/s)\n", t_before, before.tableIndex / t_before / 1e6);
+    printf("  read_token_file() best %.3f s (%.2f Mtokens/s), %.1fx faster%s\n", t_after,
+           after.tableIndex / t_after / 1e6, t_before / t_after, same ? "" : "  MISMATCH");
+
+    lexFree(&before);
+    lexFree(&after);
+    remove(TOKEN_FILE);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+/*
+    bench_vm - Interpreter vs JIT benchmark for PM/0
+
+    Runs the same PM/0 code several times with vm_run() and jit_run()
+    and reports the median time of each and the JIT speedup.
+
+    To Compile:
+        gcc -O2 -std=c11 -DVM_LIBRARY -DOBJECT_LIBRARY -o bench_vm bench_vm.c vm.c jit.c object.c
+
+    To Execute:
+        ./lex bench_loop.txt && ./parsercodegen      (bench_fib.txt for calls)
+        ./bench_vm [code file] [runs] > /dev/null
+    where:
+        [code file] defaults to elf.txt; timings are printed to stderr
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "vm.h"
+#include "jit.h"
+
+int compare_doubles(const void *a, const void *b) 
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// median wall time of `runs` runs, or -1 if the engine can't run the code
+double median_time(int (*run)(const instruction *, int, vm_stats *),
+                   const instruction *code, int count, int runs, long long *executed) 
+{
+    double *times = malloc((size_t)runs * sizeof(double));
+    vm_stats stats;
+    for (int r = 0; r < runs; r++) 
+    {
+        if (run(code, count, &stats) != VM_OK) 
+        {
+            free(times);
+            return -1;
+        }
+        times[r] = stats.seconds;
+        if (stats.instructions) *executed = stats.instructions;
+    }
+    qsort(times, runs, sizeof(double), compare_doubles);
+    double median = times[runs / 2];
+    free(times);
+    return median;
+}
+
+int main(int argc, char *argv[]) 
+{
+    const char *path = argc > 1 ? argv[1] : "elf.txt";
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+
+    instruction *code;
+    int count = vm_load_text(path, &code);
+    if (count < 0) return 1;
+
+    long long executed = 0;
+    double interp = median_time(vm_run, code, count, runs, &executed);
+    double native = median_time(jit_run, code, count, runs, &executed);
+
+    fprintf(stderr, "%s: %d instructions, %lld executed per run\n", path, count, executed);
+    fprintf(stderr, "  interpreter %.4f s (%.1f M instr/s)\n", interp, executed / interp / 1e6);
+    if (native < 0) 
+    {
+        fprintf(stderr, "  jit         unavailable for this code\n");
+    } 
+    else 
+    {
+        fprintf(stderr, "  jit         %.4f s (%.1f M instr/s), %.1fx faster\n",
+                native, executed / native / 1e6, interp / native);
+    }
+
+    free(code);
+    return 0;
+}
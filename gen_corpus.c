@@ -0,0 +1,292 @@
+/*
+    gen_corpus - Benchmark corpus generator for PL/0
+
+    Writes random PL/0 programs that follow the grammar parsercodegen.c
+    accepts (const/var declarations; assignment, write, begin ... end,
+    if ... then ... fi and while ... do statements; odd and relational
+    conditions; + - * / expressions with parentheses). The same seed
+    always gives the same program.
+
+    Every program also runs to completion on the VM: each while loop
+    counts a dedicated counter up to a small bound, nothing divides by
+    anything but a non-zero literal, and there is no read.
+
+    To Compile:
+        gcc -O2 -std=c11 -o gen_corpus gen_corpus.c
+
+    To Execute:
+        ./gen_corpus [options] > program.txt
+        ./gen_corpus [options] -n <files> -o <dir>
+    where:
+        -s <bytes>    approximate program size (default 65536)
+        -d <depth>    maximum begin/if/while nesting (default 4)
+        -i <idents>   variables declared, at least 1 (default 16)
+        -e <terms>    maximum terms per expression; parentheses nest
+                      expressions up to 3 deep (default 4)
+        -r <seed>     random seed (default 1); file k uses seed + k
+        -n <files>    write <dir>/p000.txt ... instead of stdout
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_DEPTH 32
+#define CONSTANTS 8
+#define LOOP_BOUND 3  // while loops run 1..LOOP_BOUND times
+
+typedef struct
+{
+    FILE *out;
+    unsigned long long state;  // xorshift64 state
+    long size;                 // bytes written so far
+    int depth;                 // -d
+    int idents;                // -i
+    int terms;                 // -e
+} generator;
+
+unsigned next_random(generator *g)
+{
+    g->state ^= g->state << 13;
+    g->state ^= g->state >> 7;
+    g->state ^= g->state << 17;
+    return (unsigned)(g->state >> 32);
+}
+
+int pick(generator *g, int n)
+{
+    return (int)(next_random(g) % (unsigned)n);
+}
+
+void emit(generator *g, const char *text)
+{
+    g->size += (long)strlen(text);
+    fputs(text, g->out);
+}
+
+void indent(generator *g, int level)
+{
+    for (int i = 0; i < level; i++) emit(g, "  ");
+}
+
+void expression(generator *g, int nesting);
+
+void factor(generator *g, int nesting)
+{
+    char buf[32];
+    int kind = pick(g, 10);
+    if (kind < 5) snprintf(buf, sizeof(buf), "x%d", pick(g, g->idents));
+    else if (kind < 7) snprintf(buf, sizeof(buf), "c%d", pick(g, CONSTANTS));
+    else if (kind < 9 || nesting >= 3) snprintf(buf, sizeof(buf), "%d", pick(g, 1000));
+    else
+    {
+        emit(g, "(");
+        expression(g, nesting + 1);
+        emit(g, ")");
+        return;
+    }
+    emit(g, buf);
+}
+
+void term(generator *g, int nesting)
+{
+    factor(g, nesting);
+    if (pick(g, 4) == 0)
+    {
+        char buf[32];
+        // division only by a non-zero literal, so every program runs
+        if (pick(g, 2)) snprintf(buf, sizeof(buf), " / %d", pick(g, 9) + 1);
+        else snprintf(buf, sizeof(buf), " * %d", pick(g, 9) + 1);
+        emit(g, buf);
+    }
+}
+
+void expression(generator *g, int nesting)
+{
+    int terms = 1 + pick(g, g->terms);
+    term(g, nesting);
+    for (int i = 1; i < terms; i++)
+    {
+        emit(g, pick(g, 2) ? " + " : " - ");
+        term(g, nesting);
+    }
+}
+
+void condition(generator *g)
+{
+    static const char *relations[] = {" = ", " <> ", " < ", " <= ", " > ", " >= "};
+    if (pick(g, 6) == 0)
+    {
+        emit(g, "odd ");
+        expression(g, 0);
+        return;
+    }
+    expression(g, 0);
+    emit(g, relations[pick(g, 6)]);
+    expression(g, 0);
+}
+
+void statement(generator *g, int level);
+
+// begin s; s; ... end with 1..4 statements
+void compound(generator *g, int level)
+{
+    int count = 1 + pick(g, 4);
+    emit(g, "begin\n");
+    for (int i = 0; i < count; i++)
+    {
+        indent(g, level + 1);
+        statement(g, level + 1);
+        emit(g, i + 1 < count ? ";\n" : "\n");
+    }
+    indent(g, level);
+    emit(g, "end");
+}
+
+void statement(generator *g, int level)
+{
+    char buf[64];
+    int kind = pick(g, level < g->depth ? 10 : 6);
+    if (kind < 5)
+    {
+        snprintf(buf, sizeof(buf), "x%d := ", pick(g, g->idents));
+        emit(g, buf);
+        expression(g, 0);
+    }
+    else if (kind == 5)
+    {
+        emit(g, "write ");
+        expression(g, 0);
+    }
+    else if (kind == 6)
+    {
+        compound(g, level);
+    }
+    else if (kind < 9)
+    {
+        emit(g, "if ");
+        condition(g);
+        emit(g, " then ");
+        statement(g, level + 1);
+        emit(g, " fi");
+    }
+    else
+    {
+        // w<level> belongs to this loop: nothing inside assigns it, and an
+        // inner loop uses a deeper counter
+        snprintf(buf, sizeof(buf), "begin w%d := 0; while w%d < %d do\n", level, level, 1 + pick(g, LOOP_BOUND));
+        emit(g, buf);
+        indent(g, level + 1);
+        emit(g, "begin\n");
+        indent(g, level + 2);
+        statement(g, level + 2);
+        emit(g, ";\n");
+        indent(g, level + 2);
+        snprintf(buf, sizeof(buf), "w%d := w%d + 1\n", level, level);
+        emit(g, buf);
+        indent(g, level + 1);
+        emit(g, "end end");
+    }
+}
+
+void program(generator *g, long target)
+{
+    char buf[64];
+    emit(g, "const ");
+    for (int i = 0; i < CONSTANTS; i++)
+    {
+        snprintf(buf, sizeof(buf), "c%d = %d%s", i, pick(g, 100) + 1, i + 1 < CONSTANTS ? ", " : ";\n");
+        emit(g, buf);
+    }
+    emit(g, "var ");
+    for (int i = 0; i < g->idents; i++)
+    {
+        snprintf(buf, sizeof(buf), "x%d, ", i);
+        emit(g, buf);
+        if (i % 16 == 15) emit(g, "\n    ");
+    }
+    // one counter per nesting level a loop can start at
+    for (int i = 0; i <= g->depth * 2; i++)
+    {
+        snprintf(buf, sizeof(buf), "w%d%s", i, i < g->depth * 2 ? ", " : ";\n");
+        emit(g, buf);
+    }
+
+    emit(g, "begin\n");
+    do
+    {
+        indent(g, 1);
+        statement(g, 1);
+        emit(g, g->size < target ? ";\n" : "\n");
+    } while (g->size < target);
+    emit(g, "end.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    long size = 65536;
+    int depth = 4, idents = 16, terms = 4, files = 0;
+    unsigned long long seed = 1;
+    const char *dir = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Usage: %s [-s bytes] [-d depth] [-i idents] [-e terms] [-r seed] [-n files -o dir]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "-s") == 0) size = atol(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0) depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-i") == 0) idents = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-e") == 0) terms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0) seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-n") == 0) files = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0) dir = argv[++i];
+        else
+        {
+            fprintf(stderr, "Usage: %s [-s bytes] [-d depth] [-i idents] [-e terms] [-r seed] [-n files -o dir]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (depth < 0) depth = 0;
+    if (depth > MAX_DEPTH) depth = MAX_DEPTH;
+    if (idents < 1) idents = 1;
+    if (terms < 1) terms = 1;
+    if (files > 0 && !dir)
+    {
+        fprintf(stderr, "Error: -n needs -o <dir>.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int k = 0; k < (files > 0 ? files : 1); k++)
+    {
+        generator g;
+        memset(&g, 0, sizeof(g));
+        g.state = (seed + (unsigned long long)k) * 0x9E3779B97F4A7C15ull | 1;
+        g.depth = depth;
+        g.idents = idents;
+        g.terms = terms;
+        g.out = stdout;
+
+        char path[4096];
+        if (files > 0)
+        {
+            snprintf(path, sizeof(path), "%s/p%03d.txt", dir, k);
+            g.out = fopen(path, "w");
+            if (!g.out)
+            {
+                fprintf(stderr, "Error: Could not open output file '%s'.\n", path);
+                return EXIT_FAILURE;
+            }
+        }
+        program(&g, size);
+        if (files > 0 && fclose(g.out) != 0)
+        {
+            fprintf(stderr, "Error: Could not write '%s'.\n", path);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,307 @@
+/*
+    incremental - Incremental recompilation for PL/0 (see incremental.h)
+
+    The text, its token table (each token knows where it is in the text)
+    and the code of the last compile are kept between edits.
+    Lexing is stateless between tokens, so once a re-lexed token ends at
+    the same place as an old token past the edit, every later token is
+    unchanged. Parsing restarts at the first top-level statement whose
+    tokens (or the separator it stopped at) changed and stops as soon as a
+    statement boundary lines up with an old statement past the change: the
+    statements from there on see the same tokens and symbols, so their
+    code only moves.
+
+    To Compile (with the lexer and parser, e.g. bench_incr):
+        gcc -O2 -std=c11 -DLEX_LIBRARY -DPARSER_LIBRARY -o bench_incr bench_incr.c incremental.c parsercodegen.c lex.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "incremental.h"
+
+// make room for need items in *array (capacity *cap); exits when out of memory
+static void reserve(void *array, int *cap, int need, size_t size) {
+    if (need <= *cap) return;
+    int new_cap = *cap ? *cap : 256;
+    while (new_cap < need) new_cap *= 2;
+    void *grown = realloc(*(void **)array, (size_t)new_cap * size);
+    if (!grown) {
+        fprintf(stderr, "Error: out of memory.\n");
+        exit(EXIT_FAILURE);
+    }
+    *(void **)array = grown;
+    *cap = new_cap;
+}
+
+
+void inc_init(inc_unit *u) {
+    memset(u, 0, sizeof(*u));
+    lexInit(&u->lc);
+    parser_init(&u->p);
+}
+
+
+void inc_free(inc_unit *u) {
+    lexFree(&u->lc);
+    parser_free(&u->p);
+    free(u->text);
+    free(u->code);
+    free(u->spans);
+    free(u->new_tokens);
+    free(u->new_spans);
+    inc_init(u);
+}
+
+
+static void set_text(inc_unit *u, size_t offset, size_t removed, const char *text, size_t inserted) {
+    size_t len = u->text_len - removed + inserted;
+    if (len + 1 > u->text_cap) {
+        size_t cap = u->text_cap ? u->text_cap : 4096;
+        while (cap < len + 1) cap *= 2;
+        char *grown = realloc(u->text, cap);
+        if (!grown) {
+            fprintf(stderr, "Error: out of memory.\n");
+            exit(EXIT_FAILURE);
+        }
+        u->text = grown;
+        u->text_cap = cap;
+    }
+    memmove(u->text + offset + inserted, u->text + offset + removed, u->text_len - offset - removed);
+    memcpy(u->text + offset, text, inserted);
+    u->text_len = len;
+    u->text[len] = '\0';
+    u->lc.source = u->text; // the tokens point into it
+    u->lc.sourceLen = (int)len;
+}
+
+
+// source offset just past a token
+#define TOKEN_END(t) ((t)->offset + (t)->length)
+
+// lex text from the end of token first - 1 (the start if first is 0) until
+// EOF, or until a token ends at an old token boundary at or past old_limit
+// (old offsets are new ones - shift). Fills new_tokens; returns the count
+// and sets *resync to the old token that ended there (lc.tableIndex at EOF).
+static int relex(inc_unit *u, int first, int old_limit, int shift, int *resync) {
+    lexStream ls;
+    lexeme lex;
+    int n = 0, j = first;
+    lexOpenString(&ls, u->text);
+    if (first > 0) {
+        // tokens don't span lines: the text after one is on its line
+        const lexeme *prev = &u->lc.table[first - 1];
+        lexSeek(&ls, (size_t)TOKEN_END(prev), prev->line, prev->col + prev->length);
+    }
+    *resync = u->lc.tableIndex;
+    while (nextLexeme(&u->lc, &ls, &lex)) {
+        reserve(&u->new_tokens, &u->new_token_cap, n + 1, sizeof(lexeme));
+        u->new_tokens[n++] = lex;
+
+        int old_end = TOKEN_END(&lex) - shift;
+        if (old_end < old_limit) continue;
+        while (j < u->lc.tableIndex && TOKEN_END(&u->lc.table[j]) < old_end) j++;
+        if (j < u->lc.tableIndex && TOKEN_END(&u->lc.table[j]) == old_end) {
+            *resync = j;
+            break;
+        }
+    }
+    return n;
+}
+
+
+// replace tokens [first, stop) with new_tokens[0..n); later tokens move
+// by shift bytes, and by as many lines and columns as the last replaced
+// token's end did (new_tokens[n - 1] ends where the old one did)
+static void splice_tokens(inc_unit *u, int first, int stop, int n, int shift) {
+    int count = u->lc.tableIndex;
+    int grow = n - (stop - first);
+    int old_line = 0, line_shift = 0, col_shift = 0;
+    if (stop < count && n > 0) {
+        const lexeme *old = &u->lc.table[stop - 1], *now = &u->new_tokens[n - 1];
+        old_line = old->line;
+        line_shift = now->line - old->line;
+        col_shift = (now->col + now->length) - (old->col + old->length);
+    }
+    for (int i = 0; i < grow; i++) newLexeme(&u->lc);
+    if (grow != 0) {
+        memmove(&u->lc.table[stop + grow], &u->lc.table[stop], (size_t)(count - stop) * sizeof(lexeme));
+    }
+    u->lc.tableIndex = count + grow;
+    if (n > 0) {
+        memcpy(&u->lc.table[first], u->new_tokens, (size_t)n * sizeof(lexeme));
+    }
+    if (shift != 0 || line_shift != 0 || col_shift != 0) {
+        for (int i = stop + grow; i < u->lc.tableIndex; i++) {
+            lexeme *t = &u->lc.table[i];
+            t->offset += shift;
+            if (t->line == old_line) t->col += col_shift;
+            t->line += line_shift;
+        }
+    }
+}
+
+
+// parse top-level statements from the parser's cursor into new_spans
+// (*count of them) until the body ends (returns 0), or until the next
+// statement starts at or past token changed_end where an old span k >=
+// *resync started token_shift tokens earlier (returns 1 with *resync = k).
+// -1 on an error.
+static int parse_statements(inc_unit *u, int *count, int changed_end, int token_shift, int *resync) {
+    parser_ctx *p = &u->p;
+    int n = 0, k = *resync, more;
+    do {
+        reserve(&u->new_spans, &u->new_span_cap, n + 1, sizeof(inc_span));
+        inc_span *s = &u->new_spans[n++];
+        s->first_token = p->token_ptr - 1;
+        s->first_code = p->code_index;
+        more = parse_body_statement(p);
+        if (more < 0) return -1;
+        s->end_token = p->token_ptr - 2;
+        s->end_code = p->code_index;
+
+        // the next statement is unchanged from the last compile
+        int next = p->token_ptr - 1;
+        if (more && next >= changed_end) {
+            while (k < u->span_count && u->spans[k].first_token < next - token_shift) k++;
+            if (k < u->span_count && u->spans[k].first_token == next - token_shift) {
+                *count = n;
+                *resync = k;
+                return 1;
+            }
+        }
+    } while (more);
+    *count = n;
+    return 0;
+}
+
+
+static void keep_code(inc_unit *u, int from) {
+    reserve(&u->code, &u->code_cap, u->p.code_index, sizeof(instruction));
+    memcpy(&u->code[from], &u->p.code[from], (size_t)(u->p.code_index - from) * sizeof(instruction));
+    u->code_count = u->p.code_index;
+}
+
+
+static int failed(inc_unit *u) {
+    u->ok = 0;
+    u->error_msg = u->p.error_msg;
+    return -1;
+}
+
+
+// parse all of lc.table from scratch
+static int parse_all(inc_unit *u) {
+    int n = 0, k = 0;
+    u->stats.full = 1;
+    u->span_count = 0;
+    u->resumable = 0;
+    int body = parse_body_start(&u->p, u->lc.table, u->lc.tableIndex);
+    if (body < 0) return failed(u);
+    if (body > 0) {
+        if (parse_statements(u, &n, u->lc.tableIndex, 0, &k) < 0) return failed(u);
+        reserve(&u->spans, &u->span_cap, n, sizeof(inc_span));
+        memcpy(u->spans, u->new_spans, (size_t)n * sizeof(inc_span));
+        u->span_count = n;
+        u->resumable = 1;
+    }
+    u->stats.statements_reparsed = n;
+    keep_code(u, 0);
+    u->ok = 1;
+    u->error_msg = NULL;
+    return 0;
+}
+
+
+int inc_compile(inc_unit *u, const char *text, size_t len) {
+    u->text_len = 0;
+    set_text(u, 0, 0, text, len);
+
+    memset(&u->stats, 0, sizeof(u->stats));
+    lexer(&u->lc, u->text);
+    u->stats.tokens_relexed = u->lc.tableIndex;
+    return parse_all(u);
+}
+
+
+int inc_edit(inc_unit *u, size_t offset, size_t removed, const char *text, size_t inserted) {
+    if (offset > u->text_len || removed > u->text_len - offset) {
+        fprintf(stderr, "Error: edit at %zu (%zu bytes) is outside the %zu byte source.\n", offset, removed, u->text_len);
+        return -1;
+    }
+    set_text(u, offset, removed, text, inserted);
+    memset(&u->stats, 0, sizeof(u->stats));
+    int shift = (int)inserted - (int)removed;
+
+    // re-lex from the end of the last token that ends before the edit (the
+    // token ending right at it might continue into the inserted text)
+    int lo = 0, hi = u->lc.tableIndex;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (TOKEN_END(&u->lc.table[mid]) < (int)offset) lo = mid + 1;
+        else hi = mid;
+    }
+    int first = lo, resync;
+    int n = relex(u, first, (int)(offset + removed), shift, &resync);
+    int stop = resync < u->lc.tableIndex ? resync + 1 : resync;
+    splice_tokens(u, first, stop, n, shift);
+    u->stats.tokens_relexed = n;
+    int token_shift = n - (stop - first);
+
+    if (!u->ok || !u->resumable || first < u->spans[0].first_token) {
+        return parse_all(u);
+    }
+
+    // first statement that read a changed token (its separator included)
+    lo = 0;
+    hi = u->span_count - 1; // an edit after the body re-parses the last statement
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (u->spans[mid].end_token < first) lo = mid + 1;
+        else hi = mid;
+    }
+    inc_span from = u->spans[lo];
+    int k = lo, count;
+    parse_body_resume(&u->p, u->lc.table, u->lc.tableIndex, from.first_token, from.first_code);
+    int found = parse_statements(u, &count, first + n, token_shift, &k);
+    if (found < 0) return failed(u);
+    u->stats.statements_reparsed = count;
+
+    int tail = found ? u->code_count - u->spans[k].first_code : 0;
+    int tail_spans = found ? u->span_count - k : 0;
+    int code_shift = u->p.code_index - (found ? u->spans[k].first_code : u->code_count);
+
+    // move the unchanged statements' code and spans after the new ones
+    if (found && code_shift != 0) {
+        int old_start = u->spans[k].first_code, start = u->p.code_index;
+        reserve(&u->code, &u->code_cap, start + tail, sizeof(instruction));
+        memmove(&u->code[start], &u->code[old_start], (size_t)tail * sizeof(instruction));
+        for (int i = start; i < start + tail; i++) {
+            instruction *in = &u->code[i];
+            if ((in->op == JMP || in->op == JPC || in->op == CAL) && in->m >= CODE_ADDR(old_start)) {
+                in->m += CODE_ADDR(code_shift);
+            }
+        }
+        u->stats.code_moved = tail;
+    }
+    reserve(&u->spans, &u->span_cap, lo + count + tail_spans, sizeof(inc_span));
+    if (tail_spans) {
+        memmove(&u->spans[lo + count], &u->spans[k], (size_t)tail_spans * sizeof(inc_span));
+        if (token_shift != 0 || code_shift != 0) {
+            for (int i = lo + count; i < lo + count + tail_spans; i++) {
+                u->spans[i].first_token += token_shift;
+                u->spans[i].end_token += token_shift;
+                u->spans[i].first_code += code_shift;
+                u->spans[i].end_code += code_shift;
+            }
+        }
+    }
+    memcpy(&u->spans[lo], u->new_spans, (size_t)count * sizeof(inc_span));
+    u->span_count = lo + count + tail_spans;
+
+    int new_end = u->p.code_index;
+    reserve(&u->code, &u->code_cap, new_end, sizeof(instruction));
+    memcpy(&u->code[from.first_code], &u->p.code[from.first_code], (size_t)(new_end - from.first_code) * sizeof(instruction));
+    u->code_count = new_end + tail;
+    return 0;
+}
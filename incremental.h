@@ -0,0 +1,71 @@
+/*
+    incremental.h - Incremental recompilation of one PL/0 source
+
+    Keeps a source text together with its tokens and code so that an edit
+    is compiled without redoing the whole file:
+        - only the tokens around the edit are re-lexed, until the token
+          boundaries line up with the previous lex again
+        - only the top-level statements (directly inside the main block's
+          begin ... end) whose tokens changed are re-parsed, until the
+          parser reaches the start of an unchanged statement
+        - the code of the statements after that is moved and its JMP/JPC
+          targets are relocated
+    The code is always identical to a full compile of the current text.
+    Edits to the declarations, or after a failed compile, fall back to a
+    full compile.
+*/
+
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stddef.h>
+#include "parsercodegen.h"
+
+// One top-level statement of the main block's body
+typedef struct {
+    int first_token;        // its first token
+    int end_token;          // the ';' or "end" after it
+    int first_code;         // code[first_code..end_code) is its code
+    int end_code;
+} inc_span;
+
+// What the last inc_compile()/inc_edit() did
+typedef struct {
+    int full;               // 1 if it was a full compile
+    int tokens_relexed;
+    int statements_reparsed;
+    int code_moved;         // instructions moved and relocated
+} inc_stats;
+
+typedef struct {
+    lexContext lc;          // tokens of text (identifiers interned here)
+    parser_ctx p;           // symbol table; statements are re-parsed here
+    char *text;             // current source, NUL-terminated
+    size_t text_len, text_cap;
+    instruction *code;      // code of text after a successful compile
+    int code_count, code_cap;
+    inc_span *spans;        // top-level statements, in order
+    int span_count, span_cap;
+    lexeme *new_tokens;     // scratch for inc_edit()
+    int new_token_cap;
+    inc_span *new_spans;
+    int new_span_cap;
+    int ok;                 // the last compile succeeded
+    int resumable;          // spans cover the body (it is begin ... end)
+    const char *error_msg;  // first error of a failed compile (NULL for a lexer error)
+    inc_stats stats;
+} inc_unit;
+
+void inc_init(inc_unit *u);
+void inc_free(inc_unit *u);
+
+// Full compile of text[0..len); returns 0, or -1 with u->error_msg set
+// (as parse_program()). u->code[0..u->code_count) holds the code.
+int inc_compile(inc_unit *u, const char *text, size_t len);
+
+// Replace removed bytes at offset with text[0..inserted) and recompile;
+// returns 0 or -1 like inc_compile() (-1 with a message on stderr if the
+// edit is out of range, leaving u unchanged)
+int inc_edit(inc_unit *u, size_t offset, size_t removed, const char *text, size_t inserted);
+
+#endif
@@ -0,0 +1,769 @@
+/*
+    ir - Three-address IR, CFG, value numbering and stack lowering for PM/0
+
+    ir_build() runs the parser's code through a model of the operand
+    stack, one basic block at a time: LIT/LOD/OPR/SYS read push a new
+    register, and whatever pops a value takes the register on top. The
+    parser leaves the stack empty between statements, so it is empty at
+    every jump and jump target and no register is used outside the block
+    that defines it.
+
+    ir_lower() rebuilds each register's expression tree where it is used,
+    in the original order of the STOREs, WRITEs and jumps. A register that
+    is used again later is reloaded from a variable that still holds it if
+    there is one; otherwise, if its tree can't be recomputed there (a
+    variable it loads was overwritten, or it is a READ) or rebuilding it
+    at every use takes at least as many instructions as saving it once and
+    reloading it, it is saved in a temporary on top of the frame the first
+    time it is computed.
+
+    To Compile (with the parser):
+        gcc -O2 -std=c11 -DLEX_LIBRARY -DOBJECT_LIBRARY -o parsercodegen parsercodegen.c lex.c optimizer.c object.c ir.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+
+#define MAX_LOWER_PASSES 16
+#define DATAFLOW_LIMIT (1 << 22) // blocks * frame words for constants across blocks
+
+static void *grow(void *array, int *cap, int need, size_t size) {
+    if (need <= *cap) return array;
+    int new_cap = *cap ? *cap : 256;
+    while (new_cap < need) new_cap *= 2;
+    void *grown = realloc(array, (size_t)new_cap * size);
+    if (!grown) {
+        fprintf(stderr, "Error: out of memory for the IR.\n");
+        exit(EXIT_FAILURE);
+    }
+    *cap = new_cap;
+    return grown;
+}
+
+
+void ir_init(ir_func *f) {
+    memset(f, 0, sizeof(*f));
+}
+
+
+void ir_free(ir_func *f) {
+    free(f->insts);
+    free(f->blocks);
+    free(f->preds);
+    ir_init(f);
+}
+
+
+static int add_inst(ir_func *f, int op, int a, int b, int l, int m) {
+    f->insts = grow(f->insts, &f->inst_cap, f->inst_count + 1, sizeof(ir_inst));
+    ir_inst *in = &f->insts[f->inst_count];
+    in->op = op;
+    in->a = a;
+    in->b = b;
+    in->l = l;
+    in->m = m;
+    return f->inst_count++;
+}
+
+
+// --- building ---
+
+int ir_build(ir_func *f, const instruction *code, int count) {
+    ir_free(f);
+    if (count < 1) return -1;
+    char *leader = calloc((size_t)count + 1, 1);
+    int *block_of = malloc((size_t)(count + 1) * sizeof(int));
+    int *stack = malloc((size_t)count * sizeof(int));
+    int status = -1, enters = 0;
+    if (!leader || !block_of || !stack) goto out;
+
+    // leaders: the entry, jump targets and whatever follows a jump or halt
+    leader[0] = 1;
+    for (int i = 0; i < count; i++) {
+        const instruction *in = &code[i];
+        if (in->op < LIT || in->op > SYS || in->op == CAL) goto out;
+        if ((in->op == LOD || in->op == STO) && in->l != 0) goto out;
+        if (in->op == OPR && (in->m < ADD || in->m > EVEN)) goto out; // RTN: not one frame
+        if (in->op == SYS && (in->m < SYS_WRITE || in->m > SYS_HALT)) goto out;
+        if (in->op == INC && enters++) goto out;
+        if (in->op == JMP || in->op == JPC) {
+            if (in->m < 0 || in->m % 3 != 0 || CODE_INDEX(in->m) >= count) goto out;
+            leader[CODE_INDEX(in->m)] = 1;
+        }
+        if (in->op == JMP || in->op == JPC || (in->op == SYS && in->m == SYS_HALT)) leader[i + 1] = 1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (leader[i]) block_of[i] = f->block_count++;
+    }
+    f->blocks = calloc((size_t)f->block_count, sizeof(ir_block));
+    if (!f->blocks) goto out;
+
+    int b = -1, sp = 0;
+    for (int i = 0; i < count; i++) {
+        const instruction *in = &code[i];
+        if (leader[i]) {
+            if (sp != 0) goto out;
+            b = block_of[i];
+            f->blocks[b].first = f->inst_count;
+            f->blocks[b].succ[0] = f->blocks[b].succ[1] = -1;
+        }
+        int r;
+        switch (in->op) {
+            case LIT:
+                stack[sp++] = add_inst(f, IR_CONST, -1, -1, 0, in->m);
+                break;
+            case LOD:
+                stack[sp++] = add_inst(f, IR_LOAD, -1, -1, in->l, in->m);
+                break;
+            case STO:
+                if (sp < 1) goto out;
+                add_inst(f, IR_STORE, stack[--sp], -1, in->l, in->m);
+                break;
+            case OPR:
+                if (in->m == EVEN) {
+                    if (sp < 1) goto out;
+                    r = add_inst(f, IR_EVEN, stack[sp - 1], -1, 0, 0);
+                    stack[sp - 1] = r;
+                } else {
+                    if (sp < 2) goto out;
+                    r = add_inst(f, IR_BINARY, stack[sp - 2], stack[sp - 1], 0, in->m);
+                    stack[--sp - 1] = r;
+                }
+                break;
+            case INC:
+                if (sp != 0) goto out;
+                add_inst(f, IR_ENTER, -1, -1, 0, in->m);
+                f->frame = in->m;
+                break;
+            case JMP:
+                if (sp != 0) goto out;
+                f->blocks[b].succ[0] = block_of[CODE_INDEX(in->m)];
+                add_inst(f, IR_JUMP, -1, -1, 0, f->blocks[b].succ[0]);
+                break;
+            case JPC:
+                if (sp != 1) goto out;
+                f->blocks[b].succ[0] = i + 1 < count ? block_of[i + 1] : -1;
+                f->blocks[b].succ[1] = block_of[CODE_INDEX(in->m)];
+                add_inst(f, IR_BRANCH, stack[--sp], -1, 0, f->blocks[b].succ[1]);
+                break;
+            case SYS:
+                if (in->m == SYS_WRITE) {
+                    if (sp < 1) goto out;
+                    add_inst(f, IR_WRITE, stack[--sp], -1, 0, 0);
+                } else if (in->m == SYS_READ) {
+                    stack[sp++] = add_inst(f, IR_READ, -1, -1, 0, 0);
+                } else {
+                    if (sp != 0) goto out;
+                    add_inst(f, IR_HALT, -1, -1, 0, 0);
+                }
+                break;
+        }
+        f->blocks[b].count = f->inst_count - f->blocks[b].first;
+        // falling into the next block
+        if (!leader[i + 1]) continue;
+        if (sp != 0) goto out;
+        if (in->op != JMP && in->op != JPC && !(in->op == SYS && in->m == SYS_HALT)) {
+            if (i + 1 >= count) goto out; // runs off the end of the code
+            f->blocks[b].succ[0] = block_of[i + 1];
+        }
+    }
+    if (sp != 0 || !enters) goto out;
+    for (int i = 0; i < f->inst_count; i++) {
+        const ir_inst *in = &f->insts[i];
+        if ((in->op == IR_LOAD || in->op == IR_STORE) && (in->m < 0 || in->m >= f->frame)) goto out;
+    }
+
+    // predecessor lists, grouped by block
+    int edges = 0;
+    for (int k = 0; k < f->block_count; k++) {
+        for (int s = 0; s < 2; s++) {
+            if (f->blocks[k].succ[s] >= 0) {
+                f->blocks[f->blocks[k].succ[s]].pred_count++;
+                edges++;
+            }
+        }
+    }
+    f->preds = malloc((size_t)edges * sizeof(int) + 1);
+    if (!f->preds) goto out;
+    for (int k = 0, at = 0; k < f->block_count; k++) {
+        f->blocks[k].pred_first = at;
+        at += f->blocks[k].pred_count;
+        f->blocks[k].pred_count = 0;
+    }
+    for (int k = 0; k < f->block_count; k++) {
+        for (int s = 0; s < 2; s++) {
+            int t = f->blocks[k].succ[s];
+            if (t >= 0) f->preds[f->blocks[t].pred_first + f->blocks[t].pred_count++] = k;
+        }
+    }
+    status = 0;
+
+out:
+    free(leader);
+    free(block_of);
+    free(stack);
+    if (status < 0) ir_free(f);
+    return status;
+}
+
+
+// --- value numbering ---
+
+// folds like optimizer.c: wraps like the VM and keeps run-time errors
+static int fold(int opr, int a, int b, int *result) {
+    switch (opr) {
+        case ADD: *result = (int)((unsigned)a + (unsigned)b); return 1;
+        case SUB: *result = (int)((unsigned)a - (unsigned)b); return 1;
+        case MUL: *result = (int)((unsigned)a * (unsigned)b); return 1;
+        case DIV:
+            if (b == 0) return 0;
+            *result = opr_div(a, b);
+            return 1;
+        case EQL: *result = a == b; return 1;
+        case NEQ: *result = a != b; return 1;
+        case LSS: *result = a < b; return 1;
+        case LEQ: *result = a <= b; return 1;
+        case GTR: *result = a > b; return 1;
+        case GEQ: *result = a >= b; return 1;
+    }
+    return 0;
+}
+
+
+// open-addressing table of pure expressions, emptied per block by stamp
+typedef struct {
+    int op, a, b, m;
+    int reg;
+    int stamp;
+} expr_slot;
+
+typedef struct {
+    ir_func *f;
+    ir_stats *stats;
+    expr_slot *exprs;
+    unsigned expr_mask;
+    int stamp;
+    int *consts;              // canonical IR_CONST registers by value (hash)
+    unsigned const_mask;
+    int const_used;
+    int *known;               // register each variable holds in this block
+    int *known_stamp;
+} numbering;
+
+
+static unsigned hash4(int op, int a, int b, int m) {
+    unsigned h = (unsigned)op * 2654435761u;
+    h = (h ^ (unsigned)a) * 2246822519u;
+    h = (h ^ (unsigned)b) * 3266489917u;
+    h = (h ^ (unsigned)m) * 668265263u;
+    return h ^ (h >> 15);
+}
+
+
+// the one IR_CONST register for value, added after the blocks if new
+static int const_reg(numbering *n, int value, int candidate) {
+    if ((unsigned)(n->const_used + 1) * 2 > n->const_mask + 1) {
+        unsigned size = (n->const_mask + 1) * 2;
+        int *table = malloc(size * sizeof(int));
+        if (!table) {
+            fprintf(stderr, "Error: out of memory for the IR.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (unsigned i = 0; i < size; i++) table[i] = -1;
+        for (unsigned i = 0; i <= n->const_mask; i++) {
+            int r = n->consts[i];
+            if (r < 0) continue;
+            unsigned s = hash4(IR_CONST, 0, 0, n->f->insts[r].m) & (size - 1);
+            while (table[s] >= 0) s = (s + 1) & (size - 1);
+            table[s] = r;
+        }
+        free(n->consts);
+        n->consts = table;
+        n->const_mask = size - 1;
+    }
+    unsigned s = hash4(IR_CONST, 0, 0, value) & n->const_mask;
+    while (n->consts[s] >= 0) {
+        if (n->f->insts[n->consts[s]].m == value) return n->consts[s];
+        s = (s + 1) & n->const_mask;
+    }
+    if (candidate < 0) candidate = add_inst(n->f, IR_CONST, -1, -1, 0, value);
+    n->consts[s] = candidate;
+    n->const_used++;
+    return candidate;
+}
+
+
+// earlier register computing the same pure expression, or reg (recorded)
+static int same_expr(numbering *n, int reg) {
+    const ir_inst *in = &n->f->insts[reg];
+    int a = in->a, b = in->b;
+    if (in->op == IR_BINARY && (in->m == ADD || in->m == MUL || in->m == EQL || in->m == NEQ) && a > b) {
+        a = in->b;
+        b = in->a;
+    }
+    unsigned s = hash4(in->op, a, b, in->m) & n->expr_mask;
+    while (n->exprs[s].stamp == n->stamp) {
+        expr_slot *e = &n->exprs[s];
+        if (e->op == in->op && e->a == a && e->b == b && e->m == in->m) return e->reg;
+        s = (s + 1) & n->expr_mask;
+    }
+    n->exprs[s] = (expr_slot){ in->op, a, b, in->m, reg, n->stamp };
+    return reg;
+}
+
+
+static void replace(ir_func *f, int reg, int with) {
+    f->insts[reg].op = IR_COPY;
+    f->insts[reg].a = with;
+    f->insts[reg].b = -1;
+}
+
+
+static int resolve(const ir_func *f, int reg) {
+    while (reg >= 0 && f->insts[reg].op == IR_COPY) reg = f->insts[reg].a;
+    return reg;
+}
+
+
+// number block k; in[x] is the constant register variable x holds on entry, or -1
+static void number_block(numbering *n, int k, const int *in) {
+    ir_func *f = n->f;
+    const ir_block *blk = &f->blocks[k];
+    n->stamp++;
+    if (in) {
+        for (int x = 0; x < f->frame; x++) {
+            if (in[x] < 0) continue;
+            n->known[x] = in[x];
+            n->known_stamp[x] = n->stamp;
+        }
+    }
+
+    for (int i = blk->first; i < blk->first + blk->count; i++) {
+        ir_inst *in_ = &f->insts[i];
+        in_->a = resolve(f, in_->a);
+        in_->b = resolve(f, in_->b);
+        int x = in_->m, value, r;
+        switch (in_->op) {
+            case IR_CONST:
+                r = const_reg(n, in_->m, i);
+                if (r != i) replace(f, i, r);
+                break;
+            case IR_LOAD:
+                if (x >= 0 && x < f->frame && n->known_stamp[x] == n->stamp) {
+                    replace(f, i, n->known[x]);
+                    if (n->stats) n->stats->loads++;
+                } else if (x >= 0 && x < f->frame) {
+                    n->known[x] = i;
+                    n->known_stamp[x] = n->stamp;
+                }
+                break;
+            case IR_STORE:
+                if (x < 0 || x >= f->frame) break;
+                if (n->known_stamp[x] == n->stamp && n->known[x] == in_->a) {
+                    in_->op = IR_NOP; // the variable already holds it
+                    if (n->stats) n->stats->stores++;
+                    break;
+                }
+                n->known[x] = in_->a;
+                n->known_stamp[x] = n->stamp;
+                break;
+            case IR_BINARY:
+            case IR_EVEN:
+                if (in_->op == IR_EVEN && f->insts[in_->a].op == IR_CONST) {
+                    replace(f, i, const_reg(n, f->insts[in_->a].m % 2 == 0, -1));
+                    if (n->stats) n->stats->folded++;
+                    break;
+                }
+                if (in_->op == IR_BINARY && f->insts[in_->a].op == IR_CONST && f->insts[in_->b].op == IR_CONST &&
+                    fold(in_->m, f->insts[in_->a].m, f->insts[in_->b].m, &value)) {
+                    replace(f, i, const_reg(n, value, -1));
+                    if (n->stats) n->stats->folded++;
+                    break;
+                }
+                r = same_expr(n, i);
+                if (r != i) {
+                    replace(f, i, r);
+                    if (n->stats) n->stats->cse++;
+                }
+                break;
+        }
+    }
+}
+
+
+void ir_optimize(ir_func *f, ir_stats *stats) {
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+        stats->lifted = f->inst_count;
+    }
+    if (f->block_count == 0) return;
+
+    numbering n;
+    memset(&n, 0, sizeof(n));
+    n.f = f;
+    n.stats = stats;
+    unsigned size = 16;
+    while (size < (unsigned)f->inst_count * 2) size *= 2;
+    n.exprs = calloc(size, sizeof(expr_slot));
+    n.expr_mask = size - 1;
+    n.consts = malloc(16 * sizeof(int));
+    n.const_mask = 15;
+    for (int i = 0; i < 16; i++) n.consts[i] = -1;
+    n.known = malloc(((size_t)f->frame + 1) * sizeof(int));
+    n.known_stamp = calloc((size_t)f->frame + 1, sizeof(int));
+
+    // blocks in reverse postorder, so a block's forward predecessors come first
+    int *order = malloc((size_t)f->block_count * sizeof(int));
+    int *work = malloc((size_t)f->block_count * 2 * sizeof(int));
+    char *seen = calloc((size_t)f->block_count, 1);
+    char *done = calloc((size_t)f->block_count, 1);
+    int placed = f->block_count, depth = 0;
+    long long cells = (long long)f->block_count * f->frame;
+    int *out = cells <= DATAFLOW_LIMIT ? malloc((size_t)cells * sizeof(int) + 1) : NULL;
+    int *in = malloc(((size_t)f->frame + 1) * sizeof(int));
+    if (!n.exprs || !n.consts || !n.known || !n.known_stamp || !order || !work || !seen || !done || !in) {
+        fprintf(stderr, "Error: out of memory for the IR.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    work[depth++] = 0;
+    seen[0] = 1;
+    while (depth > 0) {
+        int k = work[depth - 1], pushed = 0;
+        for (int s = 0; s < 2 && !pushed; s++) {
+            int t = f->blocks[k].succ[s];
+            if (t >= 0 && !seen[t]) {
+                seen[t] = 1;
+                work[depth++] = t;
+                pushed = 1;
+            }
+        }
+        if (!pushed) order[--placed] = work[--depth];
+    }
+    // unreachable blocks (kept for ir_lower, with nothing known on entry)
+    for (int k = f->block_count - 1; k >= 0; k--) {
+        if (!seen[k]) order[--placed] = k;
+    }
+
+    for (int o = 0; o < f->block_count; o++) {
+        int k = order[o];
+        const ir_block *blk = &f->blocks[k];
+
+        // a variable holds constant c on entry if it does at the end of
+        // every predecessor, all of which have been numbered already (the
+        // entry block also starts with nothing known)
+        int have_in = out && seen[k] && k != 0 && blk->pred_count > 0;
+        for (int p = 0; have_in && p < blk->pred_count; p++) {
+            if (!done[f->preds[blk->pred_first + p]]) have_in = 0;
+        }
+        if (have_in) {
+            for (int x = 0; x < f->frame; x++) {
+                in[x] = out[(long long)f->preds[blk->pred_first] * f->frame + x];
+                for (int p = 1; p < blk->pred_count && in[x] >= 0; p++) {
+                    if (out[(long long)f->preds[blk->pred_first + p] * f->frame + x] != in[x]) in[x] = -1;
+                }
+            }
+        }
+        number_block(&n, k, have_in ? in : NULL);
+        done[k] = 1;
+
+        if (out) {
+            int *o_ = &out[(long long)k * f->frame];
+            for (int x = 0; x < f->frame; x++) {
+                int held = n.known_stamp[x] == n.stamp ? n.known[x] : (have_in ? in[x] : -1);
+                o_[x] = held >= 0 && f->insts[held].op == IR_CONST ? held : -1;
+            }
+        }
+    }
+
+    free(n.exprs);
+    free(n.consts);
+    free(n.known);
+    free(n.known_stamp);
+    free(order);
+    free(work);
+    free(seen);
+    free(done);
+    free(out);
+    free(in);
+}
+
+
+// --- lowering ---
+
+typedef struct {
+    ir_func *f;
+    instruction *code;        // NULL while only planning
+    int count, cap;
+    int *holder;              // variable known to hold each register, -1 if none
+    int *holds;               // register each variable holds, -1 if unknown
+    int *touched;             // variables given a holds entry in this block
+    int touched_count;
+    char *wants_temp;         // registers saved in a temporary when first computed
+    int *temp;                // their slot above the frame, -1 until computed
+    int *computed;            // times each register's tree was rebuilt
+    int block_temps;          // temporaries used by this block
+    int max_temps;
+    int new_marks;            // registers that turned out to need a temporary
+    int stuck;                // a register can't be computed where it is used
+} lowering;
+
+
+static void put(lowering *w, int op, int l, int m) {
+    if (w->code) {
+        w->code = grow(w->code, &w->cap, w->count + 1, sizeof(instruction));
+        w->code[w->count] = (instruction){ op, l, m };
+    }
+    w->count++;
+}
+
+
+static void set_holds(lowering *w, int x, int reg) {
+    if (w->holds[x] == -1) w->touched[w->touched_count++] = x;
+    else if (w->holds[x] >= 0 && w->holder[w->holds[x]] == x) w->holder[w->holds[x]] = -1;
+    w->holds[x] = reg;
+    if (reg >= 0) w->holder[reg] = x;
+}
+
+
+// size of reg's tree if recomputed from scratch
+static int tree_cost(const ir_func *f, int reg) {
+    const ir_inst *in = &f->insts[reg];
+    if (in->op == IR_BINARY) return tree_cost(f, in->a) + tree_cost(f, in->b) + 1;
+    if (in->op == IR_EVEN) return tree_cost(f, in->a) + 1;
+    return 1;
+}
+
+
+// building a tree of cost instructions n times takes n * cost; a temporary
+// takes cost + 2 (STO, LOD) the first time and one LOD each time after
+static int temp_pays(int cost, int n) {
+    return (n - 1) * (cost - 1) >= 2;
+}
+
+
+// push reg's value
+static void emit_value(lowering *w, int reg) {
+    const ir_inst *in = &w->f->insts[reg];
+    if (in->op == IR_CONST) {
+        put(w, LIT, 0, in->m);
+        return;
+    }
+    if (w->temp[reg] >= 0) {
+        put(w, LOD, 0, w->temp[reg]);
+        return;
+    }
+
+    if (w->holder[reg] >= 0) {
+        put(w, LOD, 0, w->holder[reg]);
+    } else {
+        // rebuilt again: worth a temporary once that is no longer code than rebuilding
+        if (w->computed[reg] > 0 && !w->wants_temp[reg] &&
+            temp_pays(tree_cost(w->f, reg), w->computed[reg] + 1)) {
+            w->wants_temp[reg] = 1;
+            w->new_marks++;
+        }
+        switch (in->op) {
+            case IR_LOAD:
+                // the variable no longer holds the value that was loaded
+                if (w->holds[in->m] != reg) {
+                    if (w->wants_temp[reg]) w->stuck = 1;
+                    w->wants_temp[reg] = 1;
+                    w->new_marks++;
+                }
+                put(w, LOD, 0, in->m);
+                break;
+            case IR_READ:
+                if (w->computed[reg] > 0) {
+                    if (w->wants_temp[reg]) w->stuck = 1;
+                    w->wants_temp[reg] = 1;
+                    w->new_marks++;
+                }
+                put(w, SYS, 0, SYS_READ);
+                break;
+            case IR_BINARY:
+                emit_value(w, in->a);
+                emit_value(w, in->b);
+                put(w, OPR, 0, in->m);
+                break;
+            case IR_EVEN:
+                emit_value(w, in->a);
+                put(w, OPR, 0, EVEN);
+                break;
+            default:
+                w->stuck = 1;
+                return;
+        }
+        w->computed[reg]++;
+    }
+
+    // the first time a value marked for a temporary is computed
+    if (w->wants_temp[reg] && w->temp[reg] < 0) {
+        w->temp[reg] = w->f->frame + w->block_temps++;
+        if (w->block_temps > w->max_temps) w->max_temps = w->block_temps;
+        put(w, STO, 0, w->temp[reg]);
+        put(w, LOD, 0, w->temp[reg]);
+    }
+}
+
+
+// one pass over the blocks; with w->code set, writes the code
+static void lower_pass(lowering *w, int *block_start, int *jumps) {
+    ir_func *f = w->f;
+    int jump_count = 0;
+    w->count = 0;
+    w->max_temps = 0;
+    w->new_marks = 0;
+    w->stuck = 0;
+    for (int i = 0; i < f->inst_count; i++) {
+        w->holder[i] = -1;
+        w->temp[i] = -1;
+        w->computed[i] = 0;
+    }
+
+    for (int k = 0; k < f->block_count; k++) {
+        const ir_block *blk = &f->blocks[k];
+        block_start[k] = w->count;
+        w->block_temps = 0;
+        for (int i = blk->first; i < blk->first + blk->count; i++) {
+            const ir_inst *in = &f->insts[i];
+            switch (in->op) {
+                case IR_LOAD:
+                    if (in->m >= 0 && in->m < f->frame) set_holds(w, in->m, i);
+                    break;
+                case IR_STORE:
+                    emit_value(w, in->a);
+                    put(w, STO, 0, in->m);
+                    if (in->m >= 0 && in->m < f->frame) set_holds(w, in->m, in->a);
+                    break;
+                case IR_WRITE:
+                    emit_value(w, in->a);
+                    put(w, SYS, 0, SYS_WRITE);
+                    break;
+                case IR_BRANCH:
+                    emit_value(w, in->a);
+                    jumps[jump_count++] = w->count;
+                    put(w, JPC, 0, in->m);
+                    break;
+                case IR_JUMP:
+                    jumps[jump_count++] = w->count;
+                    put(w, JMP, 0, in->m);
+                    break;
+                case IR_ENTER:
+                    put(w, INC, 0, in->m + f->temps);
+                    break;
+                case IR_HALT:
+                    put(w, SYS, 0, SYS_HALT);
+                    break;
+            }
+        }
+        // registers don't outlive their block
+        for (int t = 0; t < w->touched_count; t++) {
+            int x = w->touched[t];
+            if (w->holds[x] >= 0 && w->holder[w->holds[x]] == x) w->holder[w->holds[x]] = -1;
+            w->holds[x] = -1;
+        }
+        w->touched_count = 0;
+    }
+    block_start[f->block_count] = w->count;
+
+    // block numbers -> code addresses
+    for (int j = 0; w->code && j < jump_count; j++) {
+        instruction *in = &w->code[jumps[j]];
+        in->m = CODE_ADDR(block_start[in->m]);
+    }
+}
+
+
+int ir_lower(ir_func *f, instruction **code) {
+    lowering w;
+    memset(&w, 0, sizeof(w));
+    w.f = f;
+    int n = f->inst_count;
+    w.holder = malloc(((size_t)n + 1) * sizeof(int));
+    w.holds = malloc(((size_t)f->frame + 1) * sizeof(int));
+    w.touched = malloc(((size_t)f->frame + 1) * sizeof(int));
+    w.wants_temp = calloc((size_t)n + 1, 1);
+    w.temp = malloc(((size_t)n + 1) * sizeof(int));
+    w.computed = malloc(((size_t)n + 1) * sizeof(int));
+    int *block_start = malloc(((size_t)f->block_count + 1) * sizeof(int));
+    int *jumps = malloc(((size_t)n + 1) * sizeof(int));
+    int result = -1;
+    if (!w.holder || !w.holds || !w.touched || !w.wants_temp || !w.temp || !w.computed ||
+        !block_start || !jumps) {
+        fprintf(stderr, "Error: out of memory for the IR.\n");
+        goto out;
+    }
+    for (int x = 0; x < f->frame; x++) w.holds[x] = -1;
+
+    // plan until every register that needs a temporary has one
+    f->temps = 0;
+    int pass = 0;
+    do {
+        lower_pass(&w, block_start, jumps);
+        f->temps = w.max_temps;
+    } while (w.new_marks > 0 && !w.stuck && ++pass < MAX_LOWER_PASSES);
+    if (w.new_marks > 0 || w.stuck) goto out;
+
+    // the temporaries are settled, so this pass writes the same plan
+    w.code = malloc(sizeof(instruction));
+    w.cap = 1;
+    if (!w.code) goto out;
+    lower_pass(&w, block_start, jumps);
+    *code = w.code;
+    result = w.count;
+
+out:
+    free(w.holder);
+    free(w.holds);
+    free(w.touched);
+    free(w.wants_temp);
+    free(w.temp);
+    free(w.computed);
+    free(block_start);
+    free(jumps);
+    return result;
+}
+
+
+// --- printing ---
+
+void ir_print(const ir_func *f, FILE *out) {
+    static const char *oprs[] = {"rtn", "add", "sub", "mul", "div", "eql", "neq", "lss", "leq", "gtr", "geq", "even"};
+    fprintf(out, "frame %d, %d blocks, %d instructions\n", f->frame, f->block_count, f->inst_count);
+    for (int k = 0; k < f->block_count; k++) {
+        const ir_block *blk = &f->blocks[k];
+        fprintf(out, "\nB%d:", k);
+        if (blk->pred_count) {
+            fprintf(out, " <-");
+            for (int p = 0; p < blk->pred_count; p++) fprintf(out, " B%d", f->preds[blk->pred_first + p]);
+        }
+        if (blk->succ[0] >= 0 || blk->succ[1] >= 0) {
+            fprintf(out, " ->");
+            for (int s = 0; s < 2; s++) {
+                if (blk->succ[s] >= 0) fprintf(out, " B%d", blk->succ[s]);
+            }
+        }
+        fprintf(out, "\n");
+        for (int i = blk->first; i < blk->first + blk->count; i++) {
+            const ir_inst *in = &f->insts[i];
+            switch (in->op) {
+                case IR_CONST:  fprintf(out, "    r%d = %d\n", i, in->m); break;
+                case IR_LOAD:   fprintf(out, "    r%d = load %d %d\n", i, in->l, in->m); break;
+                case IR_STORE:  fprintf(out, "    store %d %d, r%d\n", in->l, in->m, in->a); break;
+                case IR_BINARY: fprintf(out, "    r%d = %s r%d, r%d\n", i, oprs[in->m], in->a, in->b); break;
+                case IR_EVEN:   fprintf(out, "    r%d = even r%d\n", i, in->a); break;
+                case IR_READ:   fprintf(out, "    r%d = read\n", i); break;
+                case IR_WRITE:  fprintf(out, "    write r%d\n", in->a); break;
+                case IR_JUMP:   fprintf(out, "    jump B%d\n", in->m); break;
+                case IR_BRANCH: fprintf(out, "    branch r%d == 0, B%d\n", in->a, in->m); break;
+                case IR_ENTER:  fprintf(out, "    enter %d\n", in->m); break;
+                case IR_HALT:   fprintf(out, "    halt\n"); break;
+                case IR_COPY:   fprintf(out, "    r%d = r%d\n", i, in->a); break;
+                case IR_NOP:    fprintf(out, "    (removed store %d %d)\n", in->l, in->m); break;
+            }
+        }
+    }
+}
@@ -0,0 +1,91 @@
+/*
+    ir.h - Three-address IR and control-flow graph for PM/0 code
+
+    The parser's stack code is lifted into flat arrays: every instruction
+    that produces a value defines a new virtual register (its own index,
+    so each register has exactly one definition), operands name the
+    registers they read, and variables stay in memory behind LOAD and
+    STORE. Basic blocks split the instructions at jump targets and after
+    jumps, with the successor edges of the if/while structure.
+
+    ir_optimize() runs value numbering over each block in CFG order:
+    common subexpressions, repeated LOADs of a variable and LOADs of a
+    value just STOREd reuse the earlier register, constant expressions
+    fold, and constants stored on every path into a block carry over.
+    ir_lower() turns the IR back into PM/0 stack code.
+
+    Used by parsercodegen --ir (between parse_program() and --optimize).
+*/
+
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+#include "parsercodegen.h"
+
+enum ir_op {
+    IR_CONST,       // r = m
+    IR_LOAD,        // r = var(l, m)
+    IR_STORE,       // var(l, m) = a
+    IR_BINARY,      // r = a <OPR m> b, m in ADD..GEQ
+    IR_EVEN,        // r = a is even (OPR EVEN)
+    IR_READ,        // r = read (SYS 0 2)
+    IR_WRITE,       // write a (SYS 0 1)
+    IR_JUMP,        // goto block m
+    IR_BRANCH,      // if a == 0 goto block m, else fall through
+    IR_ENTER,       // allocate m words of frame (INC 0 m)
+    IR_HALT,        // SYS 0 3
+    IR_COPY,        // r = a: replaced by ir_optimize() with an earlier register
+    IR_NOP          // removed by ir_optimize()
+};
+
+typedef struct {
+    int op;         // enum ir_op
+    int a, b;       // operand registers, -1 if unused
+    int l, m;
+} ir_inst;
+
+typedef struct {
+    int first;      // insts[first..first + count)
+    int count;
+    int succ[2];    // successor blocks, -1 if none (fall-through first)
+    int pred_first; // preds[pred_first..pred_first + pred_count)
+    int pred_count;
+} ir_block;
+
+typedef struct {
+    ir_inst *insts;
+    int inst_count, inst_cap;
+    ir_block *blocks;
+    int block_count;
+    int *preds;
+    int frame;      // words allocated by the IR_ENTER
+    int temps;      // frame words added by ir_lower() for reused values
+} ir_func;
+
+typedef struct {
+    int lifted;     // IR instructions built
+    int cse;        // common subexpressions reused
+    int loads;      // redundant LOADs removed (repeats and store-to-load)
+    int folded;     // constant expressions folded
+    int stores;     // stores of a value the variable already holds
+} ir_stats;
+
+void ir_init(ir_func *f);
+void ir_free(ir_func *f);
+
+// Lift code[0..count) into f; returns 0, or -1 if the code isn't in the
+// shape the parser emits (one frame, an empty stack at every jump and
+// jump target), in which case it should be left as it is
+int ir_build(ir_func *f, const instruction *code, int count);
+
+// Value numbering over every block; stats may be NULL
+void ir_optimize(ir_func *f, ir_stats *stats);
+
+// Lower f to PM/0 into a malloc'd *code; returns the count or -1
+int ir_lower(ir_func *f, instruction **code);
+
+// Blocks and instructions, one per line (parsercodegen --dump-ir)
+void ir_print(const ir_func *f, FILE *out);
+
+#endif
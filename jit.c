@@ -0,0 +1,592 @@
+/*
+    jit - x86-64 native code generator for PM/0
+
+    Used by vm.c (./vm --jit). Compiles the whole code[] array up front:
+
+    - r12 points at stack[sp] and r13 at stack[bp] (same layout as the
+      interpreter: stack grows down, static links are stack indices),
+      r14 at stack[0] and r15 at the overflow limit.
+    - Expression stack slot d (0 = bottom) is held in one of six
+      registers, or spilled below r12 past that. The depth of every
+      instruction is found before emitting, so no stack pointer moves
+      inside expressions.
+    - OPR relational ops are cmp + setcc, JPC is test + jz, CAL/RTN use
+      native call/ret, and SYS read/write call small C helpers. rbp
+      keeps the native stack pointer of the entry, which bounds the
+      calls active as the VM does.
+    - Superinstructions (parsercodegen --fuse) compile as the plain
+      instructions they cover: the native code has no dispatch to save.
+
+    To Compile (together with the VM):
+        gcc -O2 -std=c11 -DOBJECT_LIBRARY -o vm vm.c jit.c object.c
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "jit.h"
+
+// ---- Stack depths (also used by aot.c) ----
+
+int *jit_depths(const instruction *code, int count, int *max_depth) {
+    int *depth = malloc((size_t)(count + 1) * sizeof(int));
+    char *is_target = calloc((size_t)count + 1, 1);
+    if (!depth || !is_target) {
+        free(depth);
+        free(is_target);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int op = code[i].op;
+        if (op == JMP || op == JPC || op == CAL) {
+            int t = code[i].m;
+            if (t < 0 || t % 3 != 0 || CODE_INDEX(t) > count) goto unsupported;
+            is_target[CODE_INDEX(t)] = 1;
+        }
+    }
+
+    int d = 0;
+    *max_depth = 0;
+    for (int i = 0; i < count; i++) {
+        if (is_target[i] && d != 0) goto unsupported;
+        depth[i] = d;
+        const instruction *in = &code[i];
+        switch (in->op) {
+            // a superinstruction's own slot is still its first instruction
+            case LSTO:
+            case LIT: d++; break;
+            case LLOS:
+            case LLOJ:
+            case LOD: if (in->l < 0) goto unsupported; d++; break;
+            case STO: if (in->l < 0 || d < 1) goto unsupported; d--; break;
+            case OPR:
+                if (in->m == RTN) {
+                    if (d != 0) goto unsupported;
+                    d = 0; // control doesn't fall through
+                } else if (in->m == EVEN) {
+                    if (d < 1) goto unsupported;
+                } else if (in->m >= ADD && in->m <= GEQ) {
+                    if (d < 2) goto unsupported;
+                    d--;
+                } else {
+                    goto unsupported;
+                }
+                break;
+            case CAL: if (d != 0 || in->l < 0) goto unsupported; break;
+            case INC: if (d != 0 || in->m < 0) goto unsupported; break;
+            // jump targets expect an empty expression stack
+            case JMP: if (d != 0) goto unsupported; break;
+            case JPC: if (d != 1) goto unsupported; d--; break;
+            case SYS:
+                if (in->m == SYS_WRITE) {
+                    if (d < 1) goto unsupported;
+                    d--;
+                } else if (in->m == SYS_READ) {
+                    d++;
+                } else if (in->m == SYS_HALT) {
+                    d = 0;
+                } else {
+                    goto unsupported;
+                }
+                break;
+            default: goto unsupported;
+        }
+        if (d > *max_depth) *max_depth = d;
+        // an instruction that ends control flow leaves the next one unreachable
+        // except by a jump, where the depth is 0
+        if (in->op == JMP || (in->op == OPR && in->m == RTN) || (in->op == SYS && in->m == SYS_HALT)) d = 0;
+    }
+    depth[count] = 0;
+    free(is_target);
+    return depth;
+
+unsupported:
+    free(depth);
+    free(is_target);
+    return NULL;
+}
+
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+#include <time.h>
+
+// x86-64 register numbers
+enum { RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// condition codes for jcc/setcc
+enum { CC_B = 0x2, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+// registers holding expression stack slots 0..5 (all caller-saved)
+static const int slot_reg[] = { R8, R9, R10, R11, RSI, RDI };
+#define SLOT_REGS 6
+
+// where a rel32 needs patching once every label is placed
+typedef struct {
+    size_t pos;  // offset of the rel32 field
+    int target;  // instruction index, or one of the STUB_* labels below
+} jit_fixup;
+
+enum { STUB_HALT = -1, STUB_OVERFLOW = -2, STUB_DIV_ZERO = -3, STUB_EPILOGUE = -4 };
+
+typedef struct {
+    unsigned char *buf;
+    size_t len, cap;
+    jit_fixup *fixups;
+    int fixup_count, fixup_cap;
+    int failed;
+} jit_buf;
+
+
+// ---- Helpers called from generated code ----
+
+static void jit_write(int value) {
+    printf("%d\n", value);
+}
+
+static int jit_read(void) {
+    int value;
+    if (scanf("%d", &value) != 1) value = 0;
+    return value;
+}
+
+
+// ---- Byte emitters ----
+
+static void b1(jit_buf *b, int byte) {
+    if (b->len == b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 4096;
+        unsigned char *grown = realloc(b->buf, cap);
+        if (!grown) {
+            b->failed = 1;
+            return;
+        }
+        b->buf = grown;
+        b->cap = cap;
+    }
+    b->buf[b->len++] = (unsigned char)byte;
+}
+
+static void b4(jit_buf *b, int32_t v) {
+    for (int i = 0; i < 4; i++) b1(b, (int)(((uint32_t)v >> (8 * i)) & 0xFF));
+}
+
+static void b8(jit_buf *b, uint64_t v) {
+    for (int i = 0; i < 8; i++) b1(b, (int)((v >> (8 * i)) & 0xFF));
+}
+
+// REX prefix (omitted when it would be plain 0x40)
+static void rex(jit_buf *b, int w, int reg, int rm) {
+    int r = 0x40 | (w << 3) | (((reg >> 3) & 1) << 2) | ((rm >> 3) & 1);
+    if (r != 0x40) b1(b, r);
+}
+
+static void modrm_reg(jit_buf *b, int reg, int rm) {
+    b1(b, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// [base + disp32]
+static void modrm_mem(jit_buf *b, int reg, int base, int32_t disp) {
+    b1(b, 0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP) b1(b, 0x24); // SIB for rsp/r12 base
+    b4(b, disp);
+}
+
+static void mov_r32_imm(jit_buf *b, int dst, int32_t imm) {
+    rex(b, 0, 0, dst);
+    b1(b, 0xB8 + (dst & 7));
+    b4(b, imm);
+}
+
+static void mov_r32_r32(jit_buf *b, int dst, int src) {
+    rex(b, 0, src, dst);
+    b1(b, 0x89);
+    modrm_reg(b, src, dst);
+}
+
+static void mov_r64_r64(jit_buf *b, int dst, int src) {
+    rex(b, 1, src, dst);
+    b1(b, 0x89);
+    modrm_reg(b, src, dst);
+}
+
+static void mov_r32_mem(jit_buf *b, int dst, int base, int32_t disp) {
+    rex(b, 0, dst, base);
+    b1(b, 0x8B);
+    modrm_mem(b, dst, base, disp);
+}
+
+static void mov_mem_r32(jit_buf *b, int base, int32_t disp, int src) {
+    rex(b, 0, src, base);
+    b1(b, 0x89);
+    modrm_mem(b, src, base, disp);
+}
+
+static void lea_r64_mem(jit_buf *b, int dst, int base, int32_t disp) {
+    rex(b, 1, dst, base);
+    b1(b, 0x8D);
+    modrm_mem(b, dst, base, disp);
+}
+
+// lea dst, [base + index * 4]  (base must not be rbp/r13)
+static void lea_r64_index4(jit_buf *b, int dst, int base, int index) {
+    b1(b, 0x48 | (((dst >> 3) & 1) << 2) | (((index >> 3) & 1) << 1) | ((base >> 3) & 1));
+    b1(b, 0x8D);
+    b1(b, ((dst & 7) << 3) | 0x04);
+    b1(b, 0x80 | ((index & 7) << 3) | (base & 7));
+}
+
+// 64-bit ALU op with imm32: ext 0 = add, 5 = sub
+static void alu_r64_imm(jit_buf *b, int ext, int reg, int32_t imm) {
+    rex(b, 1, 0, reg);
+    b1(b, 0x81);
+    modrm_reg(b, ext, reg);
+    b4(b, imm);
+}
+
+static void sub_r64_r64(jit_buf *b, int dst, int src) {
+    rex(b, 1, src, dst);
+    b1(b, 0x29);
+    modrm_reg(b, src, dst);
+}
+
+static void cmp_r64_r64(jit_buf *b, int left, int right) {
+    rex(b, 1, right, left);
+    b1(b, 0x39);
+    modrm_reg(b, right, left);
+}
+
+static void shr_r64_imm(jit_buf *b, int reg, int n) {
+    rex(b, 1, 0, reg);
+    b1(b, 0xC1);
+    modrm_reg(b, 5, reg);
+    b1(b, n);
+}
+
+static void push_r64(jit_buf *b, int reg) {
+    if (reg >= 8) b1(b, 0x41);
+    b1(b, 0x50 + (reg & 7));
+}
+
+static void pop_r64(jit_buf *b, int reg) {
+    if (reg >= 8) b1(b, 0x41);
+    b1(b, 0x58 + (reg & 7));
+}
+
+static void add_fixup(jit_buf *b, int target) {
+    if (b->fixup_count == b->fixup_cap) {
+        int cap = b->fixup_cap ? b->fixup_cap * 2 : 256;
+        jit_fixup *grown = realloc(b->fixups, (size_t)cap * sizeof(jit_fixup));
+        if (!grown) {
+            b->failed = 1;
+            return;
+        }
+        b->fixups = grown;
+        b->fixup_cap = cap;
+    }
+    b->fixups[b->fixup_count].pos = b->len;
+    b->fixups[b->fixup_count].target = target;
+    b->fixup_count++;
+    b4(b, 0);
+}
+
+// jmp/call/jcc rel32 to an instruction index or stub
+static void jmp_to(jit_buf *b, int target) { b1(b, 0xE9); add_fixup(b, target); }
+static void call_to(jit_buf *b, int target) { b1(b, 0xE8); add_fixup(b, target); }
+static void jcc_to(jit_buf *b, int cc, int target) { b1(b, 0x0F); b1(b, 0x80 + cc); add_fixup(b, target); }
+
+
+// ---- Expression stack slots ----
+
+static int32_t spill_disp(int slot) {
+    return -4 * (slot + 1);
+}
+
+// scratch register <- slot
+static void load_slot(jit_buf *b, int dst, int slot) {
+    if (slot < SLOT_REGS) mov_r32_r32(b, dst, slot_reg[slot]);
+    else mov_r32_mem(b, dst, R12, spill_disp(slot));
+}
+
+// slot <- scratch register
+static void store_slot(jit_buf *b, int slot, int src) {
+    if (slot < SLOT_REGS) mov_r32_r32(b, slot_reg[slot], src);
+    else mov_mem_r32(b, R12, spill_disp(slot), src);
+}
+
+// rdx <- address of stack[base(bp, l)]
+static void emit_base(jit_buf *b, int l) {
+    mov_r64_r64(b, RDX, R13);
+    while (l-- > 0) {
+        mov_r32_mem(b, RDX, RDX, 0);      // static link (a stack index)
+        lea_r64_index4(b, RDX, R14, RDX); // back to an address
+    }
+}
+
+// call a C helper with rsp 16-byte aligned, keeping slots 0..live-1;
+// arg_slot >= 0 passes that slot as the first argument
+static void emit_helper_call(jit_buf *b, void *fn, int live, int arg_slot) {
+    for (int s = 0; s < live && s < SLOT_REGS; s++) mov_mem_r32(b, R12, spill_disp(s), slot_reg[s]);
+    if (arg_slot >= 0) {
+        load_slot(b, RAX, arg_slot);
+        mov_r32_r32(b, RDI, RAX);
+    }
+    mov_r64_r64(b, RBX, RSP);
+    rex(b, 1, 0, RSP); b1(b, 0x83); modrm_reg(b, 4, RSP); b1(b, 0xF0); // and rsp, -16
+    rex(b, 1, 0, RAX); b1(b, 0xB8); b8(b, (uint64_t)(uintptr_t)fn);    // mov rax, fn
+    b1(b, 0xFF); b1(b, 0xD0);                                          // call rax
+    mov_r64_r64(b, RSP, RBX);
+    for (int s = 0; s < live && s < SLOT_REGS; s++) mov_r32_mem(b, slot_reg[s], R12, spill_disp(s));
+}
+
+
+// ---- Translation ----
+
+static void emit_instruction(jit_buf *b, const instruction *in, int index, int d) {
+    switch (in->op) {
+        case LSTO:
+        case LIT:
+            if (d < SLOT_REGS) mov_r32_imm(b, slot_reg[d], in->m);
+            else { mov_r32_imm(b, RAX, in->m); store_slot(b, d, RAX); }
+            break;
+
+        case LLOS:
+        case LLOJ:
+        case LOD:
+            if (in->l == 0) {
+                if (d < SLOT_REGS) mov_r32_mem(b, slot_reg[d], R13, -4 * in->m);
+                else { mov_r32_mem(b, RAX, R13, -4 * in->m); store_slot(b, d, RAX); }
+            } else {
+                emit_base(b, in->l);
+                mov_r32_mem(b, RAX, RDX, -4 * in->m);
+                store_slot(b, d, RAX);
+            }
+            break;
+
+        case STO:
+            load_slot(b, RAX, d - 1);
+            if (in->l == 0) {
+                mov_mem_r32(b, R13, -4 * in->m, RAX);
+            } else {
+                emit_base(b, in->l);
+                mov_mem_r32(b, RDX, -4 * in->m, RAX);
+            }
+            break;
+
+        case OPR:
+            if (in->m == RTN) {
+                lea_r64_mem(b, R12, R13, 4);      // sp = bp + 1
+                mov_r32_mem(b, RAX, R13, -4);     // bp = dynamic link
+                lea_r64_index4(b, R13, R14, RAX);
+                b1(b, 0xC3);                      // ret (pc = return address)
+                break;
+            }
+            if (in->m == EVEN) {
+                load_slot(b, RAX, d - 1);
+                b1(b, 0xA8); b1(b, 0x01);             // test al, 1
+                b1(b, 0x0F); b1(b, 0x94); b1(b, 0xC0); // sete al
+                b1(b, 0x0F); b1(b, 0xB6); b1(b, 0xC0); // movzx eax, al
+                store_slot(b, d - 1, RAX);
+                break;
+            }
+            load_slot(b, RAX, d - 2);
+            load_slot(b, RCX, d - 1);
+            switch (in->m) {
+                case ADD: b1(b, 0x01); b1(b, 0xC8); break;               // add eax, ecx
+                case SUB: b1(b, 0x29); b1(b, 0xC8); break;               // sub eax, ecx
+                case MUL: b1(b, 0x0F); b1(b, 0xAF); b1(b, 0xC1); break;  // imul eax, ecx
+                case DIV:
+                    b1(b, 0x85); b1(b, 0xC9);                            // test ecx, ecx
+                    jcc_to(b, CC_E, STUB_DIV_ZERO);
+                    // x / -1 is -x, which wraps for INT_MIN (idiv would trap)
+                    b1(b, 0x83); b1(b, 0xF9); b1(b, 0xFF);               // cmp ecx, -1
+                    b1(b, 0x75); b1(b, 0x04);                            // jne .idiv
+                    b1(b, 0xF7); b1(b, 0xD8);                            // neg eax
+                    b1(b, 0xEB); b1(b, 0x03);                            // jmp .done
+                    b1(b, 0x99);                                         // .idiv: cdq
+                    b1(b, 0xF7); b1(b, 0xF9);                            // idiv ecx; .done:
+                    break;
+                default: {
+                    int cc = in->m == EQL ? CC_E : in->m == NEQ ? CC_NE : in->m == LSS ? CC_L :
+                             in->m == LEQ ? CC_LE : in->m == GTR ? CC_G : CC_GE;
+                    b1(b, 0x39); b1(b, 0xC8);                            // cmp eax, ecx
+                    b1(b, 0x0F); b1(b, 0x90 + cc); b1(b, 0xC0);          // setcc al
+                    b1(b, 0x0F); b1(b, 0xB6); b1(b, 0xC0);               // movzx eax, al
+                    break;
+                }
+            }
+            store_slot(b, d - 2, RAX);
+            break;
+
+        case CAL:
+            emit_base(b, in->l);
+            mov_r64_r64(b, RAX, RDX);             // static link as a stack index
+            sub_r64_r64(b, RAX, R14);
+            shr_r64_imm(b, RAX, 2);
+            mov_mem_r32(b, R12, -4, RAX);
+            mov_r64_r64(b, RAX, R13);             // dynamic link
+            sub_r64_r64(b, RAX, R14);
+            shr_r64_imm(b, RAX, 2);
+            mov_mem_r32(b, R12, -8, RAX);
+            mov_r32_imm(b, RAX, index + 1);       // return address (kept for layout)
+            mov_mem_r32(b, R12, -12, RAX);
+            lea_r64_mem(b, RAX, R12, -12);
+            cmp_r64_r64(b, RAX, R15);
+            jcc_to(b, CC_B, STUB_OVERFLOW);
+            // the VM's VM_MAX_CALLS: each active call holds one native
+            // return address below rbp (past the prologue's call of main)
+            lea_r64_mem(b, RAX, RBP, -8 * (VM_MAX_CALLS + 1));
+            cmp_r64_r64(b, RSP, RAX);
+            jcc_to(b, CC_BE, STUB_OVERFLOW);
+            lea_r64_mem(b, R13, R12, -4);         // bp = sp - 1
+            call_to(b, CODE_INDEX(in->m));
+            break;
+
+        case INC:
+            alu_r64_imm(b, 5, R12, 4 * in->m);   // sub r12, 4n
+            cmp_r64_r64(b, R12, R15);
+            jcc_to(b, CC_B, STUB_OVERFLOW);
+            break;
+
+        case JMP:
+            jmp_to(b, CODE_INDEX(in->m));
+            break;
+
+        case JPC:
+            load_slot(b, RAX, d - 1);
+            b1(b, 0x85); b1(b, 0xC0);             // test eax, eax
+            jcc_to(b, CC_E, CODE_INDEX(in->m));
+            break;
+
+        case SYS:
+            if (in->m == SYS_WRITE) {
+                emit_helper_call(b, (void *)jit_write, d - 1, d - 1);
+            } else if (in->m == SYS_READ) {
+                emit_helper_call(b, (void *)jit_read, d, -1);
+                store_slot(b, d, RAX);
+            } else {
+                jmp_to(b, STUB_HALT);
+            }
+            break;
+    }
+}
+
+
+typedef int (*jit_entry)(int *stack, int *sp, int *limit);
+
+int jit_run(const instruction *code, int count, vm_stats *stats) {
+    int max_depth;
+    int *depth = jit_depths(code, count, &max_depth);
+    if (!depth) return JIT_UNSUPPORTED;
+
+    jit_buf b = {0};
+    size_t *label = malloc((size_t)(count + 1) * sizeof(size_t));
+    if (!label) {
+        free(depth);
+        return JIT_UNSUPPORTED;
+    }
+
+    // prologue: save callee-saved registers, set up the VM registers and
+    // call the program so a stray RTN in main returns here
+    push_r64(&b, RBX); push_r64(&b, RBP);
+    push_r64(&b, R12); push_r64(&b, R13); push_r64(&b, R14); push_r64(&b, R15);
+    mov_r64_r64(&b, RBP, RSP);
+    mov_r64_r64(&b, R14, RDI);
+    mov_r64_r64(&b, R12, RSI);
+    mov_r64_r64(&b, R15, RDX);
+    lea_r64_mem(&b, R13, R12, -4);
+    call_to(&b, 0);
+    jmp_to(&b, STUB_HALT);
+
+    for (int i = 0; i < count; i++) {
+        label[i] = b.len;
+        emit_instruction(&b, &code[i], i, depth[i]);
+    }
+
+    // stubs; running off the end of the code halts
+    size_t halt = b.len;
+    label[count] = halt;
+    b1(&b, 0x31); b1(&b, 0xC0);                     // xor eax, eax
+    jmp_to(&b, STUB_EPILOGUE);
+    size_t overflow = b.len;
+    mov_r32_imm(&b, RAX, VM_STACK_OVERFLOW);
+    jmp_to(&b, STUB_EPILOGUE);
+    size_t div_zero = b.len;
+    mov_r32_imm(&b, RAX, VM_DIVIDE_BY_ZERO);
+    size_t epilogue = b.len;
+    mov_r64_r64(&b, RSP, RBP);
+    pop_r64(&b, R15); pop_r64(&b, R14); pop_r64(&b, R13); pop_r64(&b, R12);
+    pop_r64(&b, RBP); pop_r64(&b, RBX);
+    b1(&b, 0xC3);
+
+    int status = JIT_UNSUPPORTED;
+    if (b.failed) goto cleanup;
+
+    for (int f = 0; f < b.fixup_count; f++) {
+        int t = b.fixups[f].target;
+        size_t dest = t >= 0 ? label[t] : t == STUB_HALT ? halt : t == STUB_OVERFLOW ? overflow :
+                      t == STUB_DIV_ZERO ? div_zero : epilogue;
+        int32_t rel = (int32_t)((long)dest - (long)(b.fixups[f].pos + 4));
+        memcpy(b.buf + b.fixups[f].pos, &rel, 4);
+    }
+
+    // W^X: write the code, then make the pages executable
+    void *exec = mmap(NULL, b.len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (exec == MAP_FAILED) goto cleanup;
+    memcpy(exec, b.buf, b.len);
+    if (mprotect(exec, b.len, PROT_READ | PROT_EXEC) != 0) {
+        munmap(exec, b.len);
+        goto cleanup;
+    }
+
+    int *stack = calloc(VM_STACK_SIZE, sizeof(int)); // variables start at 0, as in PM/0
+    if (!stack) {
+        munmap(exec, b.len);
+        goto cleanup;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    // frames stop max_depth words above stack[0]: expression slots past
+    // the registers (and the registers around helper calls) are stored
+    // below r12 without a check
+    status = ((jit_entry)exec)(stack, stack + VM_STACK_SIZE, stack + max_depth);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    fflush(stdout);
+
+    if (status == VM_STACK_OVERFLOW) {
+        fprintf(stderr, "Error: stack overflow\n");
+    } else if (status == VM_DIVIDE_BY_ZERO) {
+        fprintf(stderr, "Error: division by zero\n");
+    }
+    if (stats) {
+        stats->instructions = 0;
+        stats->seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    }
+
+    free(stack);
+    munmap(exec, b.len);
+
+cleanup:
+    free(b.buf);
+    free(b.fixups);
+    free(label);
+    free(depth);
+    return status;
+}
+
+#else
+
+int jit_run(const instruction *code, int count, vm_stats *stats) {
+    (void)code;
+    (void)count;
+    (void)stats;
+    return JIT_UNSUPPORTED;
+}
+
+#endif
@@ -0,0 +1,31 @@
+/*
+    jit.h - x86-64 JIT for PM/0 code
+
+    Translates code[] into native code in an mmap'd buffer and runs it.
+    The expression stack lives in registers (depth is known statically
+    at every instruction), so straight-line LIT/LOD/OPR/STO runs become
+    register moves and ALU ops.
+*/
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "vm.h"
+
+// jit_run() result when the code can't be compiled (not x86-64, or the
+// expression stack isn't empty at a jump target / CAL / INC / RTN);
+// the caller should use vm_run() instead
+#define JIT_UNSUPPORTED (-1)
+
+// Expression stack depth before each of code[0..count) (a malloc'd
+// array of count + 1), or NULL if some instruction can be reached with
+// different depths or pops more than was pushed; *max_depth gets the
+// deepest. The JIT and aot.c keep slot d of the expression stack in a
+// register or local of its own when this succeeds.
+int *jit_depths(const instruction *code, int count, int *max_depth);
+
+// Compile and run count instructions; returns a vm_status or
+// JIT_UNSUPPORTED. stats->instructions is left 0 (the JIT doesn't count).
+int jit_run(const instruction *code, int count, vm_stats *stats);
+
+#endif
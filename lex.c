@@ -9,6 +9,9 @@
     To Compile:
         gcc -O2 -std=c11 -o lex lex.c
 
+    To Compile as a library (used by parsercodegen.c, no main()):
+        gcc -O2 -std=c11 -DLEX_LIBRARY -c lex.c
+
     To Execute (on Eustis):
         ./lex <input file>
     where:
@@ -20,6 +23,9 @@
         - identifiers longer than eleven characters
         - invalid characters
     - The output format must exactly match the specification.
+    - Tokens don't copy their text: each records its offset and length
+      in the source, which stays in memory for the compile (lexFile()
+      reads the whole file), and the line and column it starts at.
     - Tested on Eustis.
 
     Class: COP 3402 - System Software - Fall 2025
@@ -29,35 +35,16 @@
     Due Date: Friday, October 3, 2025 at 11:59 PM ET
 */
 
+#define _POSIX_C_SOURCE 200809L // fileno() for outbuf.h
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include "lex.h"
+#include "outbuf.h"
 
-#define MAX_ID_LEN 11
-#define MAX_NUM_LEN 5
-#define MAX_SOURCE_SIZE 10000
-#define MAX_LEXEMES 500
-
-FILE *fptr;
-
-typedef enum 
-{
-    skipsym = 1, identsym, numbersym, plussym, minussym,
-    multsym, slashsym, eqlsym, neqsym,
-    lessym, leqsym, gtrsym, geqsym, lparentsym,
-    rparentsym, commasym, semicolonsym, periodsym, becomessym,
-    beginsym, endsym, ifsym, fisym, thensym, whilesym,
-    dosym, callsym, constsym, varsym, procsym,
-    writesym, readsym, elsesym, evensym
-} token_type;
-
-typedef struct 
-{
-    char lexeme[MAX_ID_LEN + 1];
-    int token;
-    int value;
-} lexeme;
+#define INITIAL_LEXEMES 500
 
 const char *reserved[] = 
 {
@@ -74,206 +61,813 @@ const int reservedTokens[] =
 
 
 const int numReserved = 15;
-char source[MAX_SOURCE_SIZE];
-lexeme table[MAX_LEXEMES];
-int tableIndex = 0;
 
-int isReserved(const char *word) 
+#ifndef LEX_CTYPE_CLASSIFY
+// Character classes for the scanner (C locale); one table lookup
+// replaces the isspace/isalpha/isdigit calls
+#define CC_SPACE 1
+#define CC_ALPHA 2
+#define CC_DIGIT 4
+#define S CC_SPACE
+#define A CC_ALPHA
+#define D CC_DIGIT
+static const unsigned char charClass[256] = 
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+#undef S
+#undef A
+#undef D
+#endif
+
+#ifdef LEX_CTYPE_CLASSIFY
+// original ctype + linear keyword search, kept for bench_lex.c comparisons
+#define IS_SPACE(c) isspace((unsigned char)(c))
+#define IS_ALPHA(c) isalpha((unsigned char)(c))
+#define IS_DIGIT(c) isdigit((unsigned char)(c))
+#define IS_ALNUM(c) isalnum((unsigned char)(c))
+#define KEYWORD_TOKEN(word, len) isReserved(word, len)
+#else
+#define IS_SPACE(c) (charClass[(unsigned char)(c)] & CC_SPACE)
+#define IS_ALPHA(c) (charClass[(unsigned char)(c)] & CC_ALPHA)
+#define IS_DIGIT(c) (charClass[(unsigned char)(c)] & CC_DIGIT)
+#define IS_ALNUM(c) (charClass[(unsigned char)(c)] & (CC_ALPHA | CC_DIGIT))
+#define KEYWORD_TOKEN(word, len) keywordToken(word, len)
+#endif
+
+// Perfect hash of reserved[]: (length + 4 * second char) % 32 gives every
+// keyword its own slot, so a word is checked against at most one entry
+#define KEYWORD_SLOTS 32
+#define KEYWORD_HASH(word, len) (((len) + 4 * (unsigned char)(word)[1]) & (KEYWORD_SLOTS - 1))
+
+typedef struct 
+{
+    const char *word;
+    int len;
+    int token;
+} keyword;
+
+static const keyword keywordSlots[KEYWORD_SLOTS] = 
+{
+    [1]  = {"const", 5, constsym},
+    [4]  = {"then", 4, thensym},
+    [5]  = {"while", 5, whilesym},
+    [6]  = {"fi", 2, fisym},
+    [7]  = {"var", 3, varsym},
+    [8]  = {"call", 4, callsym},
+    [13] = {"write", 5, writesym},
+    [17] = {"procedure", 9, procsym},
+    [19] = {"odd", 3, evensym},
+    [20] = {"else", 4, elsesym},
+    [24] = {"read", 4, readsym},
+    [25] = {"begin", 5, beginsym},
+    [26] = {"if", 2, ifsym},
+    [27] = {"end", 3, endsym},
+    [30] = {"do", 2, dosym},
+};
+int isReserved(const char *word, int len) 
 {
     for (int i = 0; i < numReserved; i++) 
     {
-        if (strcmp(word, reserved[i]) == 0)
+        if (strncmp(word, reserved[i], len) == 0 && reserved[i][len] == '\0')
             return reservedTokens[i];
     }
     return 0;
 }
 
-void addLexeme(const char *word, int token, int value) 
+void lexInit(lexContext *lc) 
+{
+    memset(lc, 0, sizeof(*lc));
+    arena_init(&lc->mem);
+}
+
+void lexFree(lexContext *lc) 
 {
-    // prevents overflow
-    if (tableIndex >= MAX_LEXEMES) return;
-    // copy word to lexeme table
-    strncpy(table[tableIndex].lexeme, word, MAX_ID_LEN);
-    table[tableIndex].token = token;
-    table[tableIndex].value = value;
-    tableIndex++;
+    arena_free(&lc->mem);
+    lexInit(lc);
 }
 
-void error(const int msg, const char *context) 
+void lexReset(lexContext *lc) 
 {
-    if (tableIndex >= MAX_LEXEMES) return;
-    // copy context to lexeme table (for errors only)
-    strncpy(table[tableIndex].lexeme, context, MAX_ID_LEN);
-    table[tableIndex].token = msg;
-    table[tableIndex].value = 1;
-    tableIndex++;
+    arena mem = lc->mem;
+    arena_reset(&mem);
+    memset(lc, 0, sizeof(*lc));
+    lc->mem = mem;
 }
 
-void handleComment(const char *input, int *i) 
+// resize an array held in lc->mem to hold at least need elements (doubling)
+static void *growArray(lexContext *lc, void *array, int *cap, int need, size_t elemSize) 
 {
-    *i += 2; // Skip the opening "/*"
-    while (input[*i] != '\0' && !(input[*i] == '*' && input[*i + 1] == '/')) 
+    if (need <= *cap) return array;
+    int newCap = *cap ? *cap : 64;
+    while (newCap < need) newCap *= 2;
+    void *grown = arena_grow(&lc->mem, array, (size_t)*cap * elemSize, (size_t)newCap * elemSize);
+    if (!grown) 
     {
-        (*i)++;
+        fprintf(stderr, "Error: out of memory for lexer tables\n");
+        exit(EXIT_FAILURE);
     }
-    if (input[*i] == '\0') 
+    *cap = newCap;
+    return grown;
+}
+
+// make room for one more entry in table (doubles the capacity when full)
+void growTable(lexContext *lc) 
+{
+    if (lc->tableIndex < lc->tableCapacity) return;
+    int need = lc->tableCapacity ? lc->tableCapacity * 2 : INITIAL_LEXEMES;
+    lc->table = growArray(lc, lc->table, &lc->tableCapacity, need, sizeof(lexeme));
+}
+
+lexeme *newLexemes(lexContext *lc, int n) 
+{
+    lc->table = growArray(lc, lc->table, &lc->tableCapacity, lc->tableIndex + n, sizeof(lexeme));
+    lexeme *first = &lc->table[lc->tableIndex];
+    lc->tableIndex += n;
+    return first;
+}
+
+lexeme *newLexeme(lexContext *lc) 
+{
+    growTable(lc);
+    lexeme *lex = &lc->table[lc->tableIndex++];
+    memset(lex, 0, sizeof(*lex));
+    return lex;
+}
+
+// token for a reserved word word[0..len), 0 if not reserved
+int keywordToken(const char *word, int len) 
+{
+    if (len < 2) return 0; // no one-letter keywords; word[1] may not exist
+    const keyword *k = &keywordSlots[KEYWORD_HASH(word, len)];
+    if (k->len == len && memcmp(k->word, word, len) == 0)
+        return k->token;
+    return 0;
+}
+
+// ---- Identifier interning ----
+// Every distinct identifier gets a dense ID the first time it is seen.
+// Names live back to back in lc->identText; lc->identSlots is an
+// open-addressing hash of (ID + 1), 0 meaning empty.
+
+static unsigned hashIdent(const char *word, int len) 
+{
+    unsigned h = 2166136261u; // FNV-1a
+    for (int i = 0; i < len; i++) 
+    {
+        h = (h ^ (unsigned char)word[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void rehashIdents(lexContext *lc, int slotCount) 
+{
+    // the old slots stay in the arena until the next reset
+    lc->identSlots = arena_alloc(&lc->mem, (size_t)slotCount * sizeof(int));
+    if (!lc->identSlots) 
+    {
+        fprintf(stderr, "Error: out of memory for identifier table\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(lc->identSlots, 0, (size_t)slotCount * sizeof(int));
+    lc->identSlotCount = slotCount;
+    for (int id = 0; id < lc->identCount; id++) 
+    {
+        const char *name = lc->identText + lc->identOffset[id];
+        unsigned slot = hashIdent(name, (int)strlen(name)) & (slotCount - 1);
+        while (lc->identSlots[slot]) slot = (slot + 1) & (slotCount - 1);
+        lc->identSlots[slot] = id + 1;
+    }
+}
+
+// ID for the identifier word[0..len), adding it if it's new
+int internIdent(lexContext *lc, const char *word, int len) 
+{
+    if (lc->identSlotCount == 0) rehashIdents(lc, 256);
+
+    unsigned mask = (unsigned)lc->identSlotCount - 1;
+    unsigned slot = hashIdent(word, len) & mask;
+    while (lc->identSlots[slot]) 
+    {
+        const char *name = lc->identText + lc->identOffset[lc->identSlots[slot] - 1];
+        if (strncmp(name, word, len) == 0 && name[len] == '\0')
+            return lc->identSlots[slot] - 1;
+        slot = (slot + 1) & mask;
+    }
+
+    int id = lc->identCount++;
+    lc->identOffset = growArray(lc, lc->identOffset, &lc->identCap, lc->identCount, sizeof(int));
+    lc->identText = growArray(lc, lc->identText, &lc->identTextCap, lc->identTextLen + len + 1, 1);
+    lc->identOffset[id] = lc->identTextLen;
+    memcpy(lc->identText + lc->identTextLen, word, len);
+    lc->identText[lc->identTextLen + len] = '\0';
+    lc->identTextLen += len + 1;
+
+    if (lc->identCount * 2 > lc->identSlotCount) rehashIdents(lc, lc->identSlotCount * 2);
+    else lc->identSlots[slot] = id + 1;
+    return id;
+}
+
+const char *identName(const lexContext *lc, int id) 
+{
+    return lc->identText + lc->identOffset[id];
+}
+
+// ---- Run scanners ----
+// Each returns how many leading bytes of p[0..n) belong to the run. The
+// SSE2/AVX2 versions test 16/32 bytes per step and finish with the scalar
+// loop; selectScanners() picks the widest one the CPU supports.
+
+typedef size_t (*spanFn)(const char *p, size_t n);
+
+static size_t spanSpacesScalar(const char *p, size_t n) 
+{
+    size_t i = 0;
+    while (i < n && IS_SPACE(p[i])) i++;
+    return i;
+}
+
+static size_t spanAlnumScalar(const char *p, size_t n) 
+{
+    size_t i = 0;
+    while (i < n && IS_ALNUM(p[i])) i++;
+    return i;
+}
+
+static size_t spanDigitsScalar(const char *p, size_t n) 
+{
+    size_t i = 0;
+    while (i < n && IS_DIGIT(p[i])) i++;
+    return i;
+}
+
+// comment text up to a "*/", a '\0', or a '*' that is the last byte of p
+// (its partner may be in the next chunk)
+static size_t spanCommentScalar(const char *p, size_t n) 
+{
+    for (size_t i = 0; i < n; i++) 
+    {
+        if (p[i] == '\0') return i;
+        if (p[i] == '*' && (i + 1 == n || p[i + 1] == '/')) return i;
+    }
+    return n;
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(LEX_NO_SIMD)
+#define LEX_HAVE_SIMD 1
+#include <immintrin.h>
+
+// bytes of v in [lo, lo + width] (unsigned)
+#define IN_RANGE_128(v, lo, width) \
+    _mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8(v, _mm_set1_epi8(lo)), _mm_set1_epi8(width)), \
+                   _mm_sub_epi8(v, _mm_set1_epi8(lo)))
+#define IN_RANGE_256(v, lo, width) \
+    _mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8(lo)), _mm256_set1_epi8(width)), \
+                      _mm256_sub_epi8(v, _mm256_set1_epi8(lo)))
+
+static size_t spanSpacesSSE2(const char *p, size_t n) 
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) 
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i ws = _mm_or_si128(IN_RANGE_128(v, '\t', '\r' - '\t'),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(ws) & 0xFFFFu;
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + spanSpacesScalar(p + i, n - i);
+}
+
+static size_t spanAlnumSSE2(const char *p, size_t n) 
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) 
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i ok = _mm_or_si128(IN_RANGE_128(v, '0', 9), IN_RANGE_128(lower, 'a', 25));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(ok) & 0xFFFFu;
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + spanAlnumScalar(p + i, n - i);
+}
+
+static size_t spanDigitsSSE2(const char *p, size_t n) 
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) 
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(IN_RANGE_128(v, '0', 9)) & 0xFFFFu;
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + spanDigitsScalar(p + i, n - i);
+}
+
+static size_t spanCommentSSE2(const char *p, size_t n) 
+{
+    size_t i = 0;
+    for (; i + 17 <= n; i += 16) 
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i next = _mm_loadu_si128((const __m128i *)(p + i + 1));
+        __m128i end = _mm_and_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('*')),
+                                    _mm_cmpeq_epi8(next, _mm_set1_epi8('/')));
+        end = _mm_or_si128(end, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+        unsigned stop = (unsigned)_mm_movemask_epi8(end);
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + spanCommentScalar(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t spanSpacesAVX2(const char *p, size_t n) 
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) 
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i ws = _mm256_or_si256(IN_RANGE_256(v, '\t', '\r' - '\t'),
+                                     _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(ws);
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + spanSpacesSSE2(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t spanAlnumAVX2(const char *p, size_t n) 
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) 
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i ok = _mm256_or_si256(IN_RANGE_256(v, '0', 9), IN_RANGE_256(lower, 'a', 25));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(ok);
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + spanAlnumSSE2(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t spanDigitsAVX2(const char *p, size_t n) 
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) 
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(IN_RANGE_256(v, '0', 9));
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + spanDigitsSSE2(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t spanCommentAVX2(const char *p, size_t n) 
+{
+    size_t i = 0;
+    for (; i + 33 <= n; i += 32) 
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i next = _mm256_loadu_si256((const __m256i *)(p + i + 1));
+        __m256i end = _mm256_and_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('*')),
+                                       _mm256_cmpeq_epi8(next, _mm256_set1_epi8('/')));
+        end = _mm256_or_si256(end, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+        unsigned stop = (unsigned)_mm256_movemask_epi8(end);
+        if (stop) return i + __builtin_ctz(stop);
+    }
+    return i + spanCommentSSE2(p + i, n - i);
+}
+#endif
+
+static spanFn spanSpaces = spanSpacesScalar;
+static spanFn spanAlnum = spanAlnumScalar;
+static spanFn spanDigits = spanDigitsScalar;
+static spanFn spanComment = spanCommentScalar;
+const char *lexScanner = "scalar";
+
+// pick scanners for this CPU; PL0_SIMD=scalar|sse2|avx2 caps the choice
+void selectScanners() 
+{
+    static int selected = 0;
+    if (selected) return;
+    selected = 1;
+
+#ifdef LEX_HAVE_SIMD
+    const char *want = getenv("PL0_SIMD");
+    if (want && strcmp(want, "scalar") == 0) return;
+
+    spanSpaces = spanSpacesSSE2;
+    spanAlnum = spanAlnumSSE2;
+    spanDigits = spanDigitsSSE2;
+    spanComment = spanCommentSSE2;
+    lexScanner = "sse2";
+    if (want && strcmp(want, "sse2") == 0) return;
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) 
+    {
+        spanSpaces = spanSpacesAVX2;
+        spanAlnum = spanAlnumAVX2;
+        spanDigits = spanDigitsAVX2;
+        spanComment = spanCommentAVX2;
+        lexScanner = "avx2";
+    }
+#endif
+}
+
+void lexOpenString(lexStream *ls, const char *input) 
+{
+    lexOpenRange(ls, input, 0, strlen(input));
+}
+
+void lexOpenRange(lexStream *ls, const char *input, size_t start, size_t end) 
+{
+    selectScanners();
+    ls->fp = NULL;
+    ls->chunk = NULL;
+    ls->data = input;
+    ls->len = end;
+    lexSeek(ls, start, 1, 1);
+}
+
+void lexSeek(lexStream *ls, size_t pos, int line, int col) 
+{
+    ls->pos = pos;
+    ls->base = 0;
+    ls->mark = pos;
+    ls->line = line;
+    ls->lineStart = pos - (size_t)(col - 1);
+    ls->inComment = 0;
+}
+
+int lexOpenFile(lexStream *ls, FILE *fp) 
+{
+    selectScanners();
+    ls->fp = fp;
+    ls->chunk = malloc(LEX_CHUNK_SIZE);
+    if (!ls->chunk) return -1;
+    ls->data = ls->chunk;
+    ls->len = 0;
+    lexSeek(ls, 0, 1, 1);
+    return 0;
+}
+
+void lexClose(lexStream *ls) 
+{
+    free(ls->chunk);
+    ls->chunk = NULL;
+    ls->data = NULL;
+}
+
+// character k places ahead of the read position, '\0' at end of input.
+// When reading a file, the unread tail is slid to the front of the chunk
+// and the rest refilled, so tokens and comments may span chunk boundaries.
+// The current token's text (from mark) is slid along with it unless it
+// is already longer than any token whose text is used (a skipsym run).
+static char peekChar(lexStream *ls, size_t k) 
+{
+    if (ls->pos + k >= ls->len && ls->fp) 
+    {
+        size_t keep = ls->pos - ls->mark <= MAX_ID_LEN ? ls->mark : ls->pos;
+        size_t left = ls->len - keep;
+        memmove(ls->chunk, ls->chunk + keep, left);
+        ls->len = left + fread(ls->chunk + left, 1, LEX_CHUNK_SIZE - left, ls->fp);
+        ls->base += keep;
+        ls->pos -= keep;
+        ls->mark = keep == ls->mark ? 0 : ls->pos;
+    }
+    if (ls->pos + k >= ls->len) return '\0';
+    return ls->data[ls->pos + k];
+}
+
+// move the read position n bytes on, counting the lines passed
+static void skipText(lexStream *ls, size_t n) 
+{
+    const char *p = ls->data + ls->pos, *end = p + n;
+    while ((p = memchr(p, '\n', (size_t)(end - p))) != NULL) 
+    {
+        p++;
+        ls->line++;
+        ls->lineStart = ls->base + (size_t)(p - ls->data);
+    }
+    ls->pos += n;
+}
+
+// consume a run matched by span (continuing across chunk refills);
+// returns the full run length. Runs inside tokens don't hold newlines.
+static size_t scanRun(lexStream *ls, spanFn span) 
+{
+    size_t total = 0;
+    while (peekChar(ls, 0) != '\0') 
+    {
+        size_t n = span(ls->data + ls->pos, ls->len - ls->pos);
+        total += n;
+        ls->pos += n;
+        if (ls->pos < ls->len) break; // run ended inside this chunk
+    }
+    return total;
+}
+
+// whitespace, which may span chunk refills
+static void skipSpaces(lexStream *ls) 
+{
+    while (peekChar(ls, 0) != '\0') 
+    {
+        skipText(ls, spanSpaces(ls->data + ls->pos, ls->len - ls->pos));
+        if (ls->pos < ls->len) break;
+    }
+}
+
+void handleComment(lexStream *ls) 
+{
+    ls->pos += 2; // Skip the opening "/*"
+    lexSkipComment(ls);
+}
+
+void lexSkipComment(lexStream *ls) 
+{
+    while (peekChar(ls, 0) != '\0' && !(peekChar(ls, 0) == '*' && peekChar(ls, 1) == '/')) 
+    {
+        size_t n = spanComment(ls->data + ls->pos, ls->len - ls->pos);
+        skipText(ls, n ? n : 1); // n == 0: a lone '*' whose next byte was just refilled
+    }
+    if (peekChar(ls, 0) == '\0') 
     {
         // Unclosed comment - handle gracefully, just return
+        ls->inComment = 1;
         return;
     }
-    *i += 2; 
+    ls->pos += 2; 
 }
 
-void lexer(const char *input) 
+// one-character symbol tokens; 0 where a character doesn't start one
+static const unsigned char singleToken[256] = 
+{
+    ['+'] = plussym, ['-'] = minussym, ['*'] = multsym, ['/'] = slashsym,
+    ['='] = eqlsym, ['<'] = lessym, ['>'] = gtrsym, ['('] = lparentsym,
+    [')'] = rparentsym, [','] = commasym, [';'] = semicolonsym, ['.'] = periodsym,
+};
+
+int nextLexeme(lexContext *lc, lexStream *ls, lexeme *out) 
 {
-    int i = 0;
+    char c;
     // while we don't reach null terminator
-    while (input[i] != '\0') 
+    while ((c = peekChar(ls, 0)) != '\0') 
     {
-        if (isspace(input[i])) { i++; continue; }
+        if (IS_SPACE(c)) { skipSpaces(ls); continue; }
 
-        if (input[i] == '/' && input[i + 1] == '*') 
+        if (c == '/' && peekChar(ls, 1) == '*') 
         {
-            handleComment(input, &i);
+            handleComment(ls);
             continue;
         }
 
+        // the token starts here; its text stays in data[mark, pos)
+        ls->mark = ls->pos;
+        out->offset = (int)(ls->base + ls->pos);
+        out->line = ls->line;
+        out->col = (int)(ls->base + ls->pos - ls->lineStart) + 1;
+        out->value = 0;
+
         // identifier or reserved word
-        if (isalpha(input[i])) 
+        if (IS_ALPHA(c)) 
         {
-            char buffer[MAX_ID_LEN + 5]; int j = 0;
-            while (isalnum(input[i]) && j < MAX_ID_LEN) buffer[j++] = input[i++];
-            buffer[j] = '\0';
+            size_t run = scanRun(ls, spanAlnum);
+            out->length = (int)run;
 
             // If identifier is too long, set to skipsym
-            if (isalnum(input[i])) 
+            if (run > MAX_ID_LEN) 
             {
-                while (isalnum(input[i])) i++; // Skip the rest of the identifier
-                addLexeme(buffer, skipsym, 0); // Mark as skipsym
-                continue;
+                out->token = skipsym;
+                return 1;
             }
-            
-            int res = isReserved(buffer);
-            if (res) addLexeme(buffer, res, 0);
-            else addLexeme(buffer, identsym, 0);
-            continue;
+
+            const char *word = ls->data + ls->mark;
+            int res = KEYWORD_TOKEN(word, (int)run);
+            if (res) out->token = res;
+            else 
+            {
+                // identifiers carry their interned ID; only a new name is copied
+                out->token = identsym;
+                out->value = internIdent(lc, word, (int)run);
+            }
+            return 1;
         }
 
         // number
-        if (isdigit(input[i])) 
+        if (IS_DIGIT(c)) 
         {
-            char buffer[MAX_NUM_LEN + 5]; int j = 0;
-            while (isdigit(input[i]) && j < MAX_NUM_LEN) buffer[j++] = input[i++];
-            buffer[j] = '\0';
+            size_t run = scanRun(ls, spanDigits);
+            out->length = (int)run;
 
             // If number is too long, set to skipsym
-            if (isdigit(input[i])) 
+            if (run > MAX_NUM_LEN) 
             {
-                while (isdigit(input[i])) i++; // Skip the rest of the number
-                addLexeme(buffer, skipsym, 0); // Mark as skipsym
-                continue;
+                out->token = skipsym;
+                return 1;
             }
-            
-            addLexeme(buffer, numbersym, atoi(buffer));
-            continue;
+
+            const char *digits = ls->data + ls->mark;
+            for (size_t i = 0; i < run; i++) out->value = out->value * 10 + (digits[i] - '0');
+            out->token = numbersym;
+            return 1;
         }
 
         // special symbols
-        switch (input[i]) 
+        char next = peekChar(ls, 1);
+        out->length = 1;
+        switch (c) 
         {
-            case '+': addLexeme("+", plussym, 0); i++; break;
-            case '-': addLexeme("-", minussym, 0); i++; break;
-            case '*': addLexeme("*", multsym, 0); i++; break;
-            case '/': addLexeme("/", slashsym, 0); i++; break;
-            case '=': addLexeme("=", eqlsym, 0); i++; break;
             case '<':
-                if (input[i + 1] == '=') { addLexeme("<=", leqsym, 0); i += 2; }
-                else if (input[i + 1] == '>') { addLexeme("<>", neqsym, 0); i += 2; }
-                else { addLexeme("<", lessym, 0); i++; }
+                if (next == '=') { out->token = leqsym; out->length = 2; }
+                else if (next == '>') { out->token = neqsym; out->length = 2; }
+                else out->token = lessym;
                 break;
             case '>':
-                if (input[i + 1] == '=') { addLexeme(">=", geqsym, 0); i += 2; }
-                else { addLexeme(">", gtrsym, 0); i++; }
+                if (next == '=') { out->token = geqsym; out->length = 2; }
+                else out->token = gtrsym;
                 break;
             case ':':
-                if (input[i + 1] == '=') { addLexeme(":=", becomessym, 0); i += 2; }
-                else { i++; } // Skip lone colon - handle gracefully
-                break;
-            case '(': addLexeme("(", lparentsym, 0); i++; break;
-            case ')': addLexeme(")", rparentsym, 0); i++; break;
-            case ',': addLexeme(",", commasym, 0); i++; break;
-            case ';': addLexeme(";", semicolonsym, 0); i++; break;
-            case '.': addLexeme(".", periodsym, 0); i++; break;
-
-            // Skip invalid symbols gracefully - don't generate error tokens
+                if (next == '=') { out->token = becomessym; out->length = 2; break; }
+                ls->pos++; // Skip lone colon - handle gracefully
+                continue;
             default:
-                addLexeme(&input[i], skipsym, 0); // Mark invalid symbol as skipsym
-                i++; // Move to the next character
+                out->token = singleToken[(unsigned char)c];
+                // Mark invalid symbol as skipsym (no error tokens are generated)
+                if (!out->token) out->token = skipsym;
                 break;
         }
+        ls->pos += out->length;
+        return 1;
     }
+    return 0;
+}
+
+// lex everything from an open stream into lc->table
+void lexAll(lexContext *lc, lexStream *ls) 
+{
+    lexeme lex;
+    while (nextLexeme(lc, ls, &lex)) 
+    {
+        growTable(lc);
+        lc->table[lc->tableIndex++] = lex;
+    }
+}
+
+void lexer(lexContext *lc, const char *input) 
+{
+    lexStream ls;
+    lexReset(lc);
+    lc->source = input;
+    lexOpenString(&ls, input);
+    lc->sourceLen = (int)ls.len;
+    lexAll(lc, &ls);
+}
+
+// lex a whole source file into lc->table (a fresh compilation); the text
+// is read into lc->mem first so the tokens can point into it. Returns -1
+// if it can't be read.
+int lexFile(lexContext *lc, const char *path) 
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) 
+    {
+        perror("File open error");
+        return -1;
+    }
+
+    lexReset(lc);
+    char *text = NULL;
+    size_t len = 0, cap = 0, n;
+    do 
+    {
+        if (len + LEX_CHUNK_SIZE + 1 > cap) 
+        {
+            size_t newCap = cap ? cap * 2 : LEX_CHUNK_SIZE + 1;
+            text = arena_grow(&lc->mem, text, cap, newCap);
+            if (!text) 
+            {
+                fprintf(stderr, "Error: out of memory for source file\n");
+                fclose(fp);
+                return -1;
+            }
+            cap = newCap;
+        }
+        n = fread(text + len, 1, LEX_CHUNK_SIZE, fp);
+        len += n;
+    } while (n > 0);
+    fclose(fp);
+    text[len] = '\0';
+
+    lexStream ls;
+    lc->source = text;
+    lexOpenString(&ls, text);
+    lc->sourceLen = (int)ls.len;
+    lexAll(lc, &ls);
+    return 0;
+}
+
+const char *lexText(const lexContext *lc, const lexeme *lex) 
+{
+    return lc->source ? lc->source + lex->offset : NULL;
 }
 
 void printSource(const char *input) 
 {
     printf("Source Program:\n\n%s\n", input);
 }
-
-void printLexemeTable() 
+void printLexemeTable(const lexContext *lc) 
 {
     printf("\nLexeme Table:\n");
     printf("\n");
     printf("lexeme\t     token type\n");
     // loop through and print table
-    for (int i=0; i<tableIndex; i++) 
+    const lexeme *table = lc->table;
+    for (int i=0; i<lc->tableIndex; i++) 
     {
-        // error handling
-        if(table[i].token > 0)
+        if(table[i].token == identsym)
         {
-            printf("%-12s %d\n", table[i].lexeme, table[i].token);
+            printf("%-12s %d\n", identName(lc, table[i].value), table[i].token);
         } 
-        else if(table[i].token == -1)
+        else if(table[i].token == skipsym)
         {
-            printf("%-12s %s\n", table[i].lexeme, "Indentifier too long");
+            printf("%-12.*s %s\n", table[i].length, lexText(lc, &table[i]), "Invalid token");
         } 
-        else if(table[i].token == -2)
+        else if(table[i].token > 0)
         {
-            printf("%-12s %s\n", table[i].lexeme, "Number too long");
+            printf("%-12.*s %d\n", table[i].length, lexText(lc, &table[i]), table[i].token);
         } 
-        else if(table[i].token == -3)
-        {
-            printf("%-12s %s\n", table[i].lexeme, "Invalid Symbol");
-        }
-        
     }
     printf("\n");
 }
 
-void printTokenList() 
+// append one token in the tokens.txt format to o
+static void outLexeme(outbuf *o, const lexContext *lc, const lexeme *lex) 
+{
+    // Only output valid tokens (positive token values)
+    // Do NOT output error tokens (negative values) as skipsym
+    if (lex->token <= 0) return;
+
+    out_int(o, lex->token);
+    out_char(o, ' ');
+    if (lex->token == identsym) 
+    {
+        out_str(o, identName(lc, lex->value));
+        out_char(o, ' ');
+    }
+    else if (lex->token == numbersym) 
+    {
+        // the digits as written ("%0*d"): a number is never longer than its digits
+        out_int_pad(o, lex->value, lex->length, '0');
+        out_char(o, ' ');
+    }
+}
+
+// write one token in the tokens.txt format
+void printLexeme(FILE *out, const lexContext *lc, const lexeme *lex) 
+{
+    outbuf o;
+    out_begin(&o, out);
+    outLexeme(&o, lc, lex);
+    out_end(&o);
+}
+
+void printTokenList(FILE *out, const lexContext *lc) 
 {
     // printf("Token List:\n");
     // printf("\n");
-    for (int i=0; i<tableIndex; i++) 
+    outbuf o;
+    out_begin(&o, out);
+    for (int i=0; i<lc->tableIndex; i++) 
     {
-        // Only output valid tokens (positive token values)
-        // Do NOT output error tokens (negative values) as skipsym
-        if(table[i].token > 0)
-        {
-            fprintf(fptr, "%d ", table[i].token);
-            
-            if (table[i].token == identsym || table[i].token == numbersym) 
-            {
-                fprintf(fptr, "%s ", table[i].lexeme);
-            }
-        }
-        // Skip error tokens - don't output anything for them
+        outLexeme(&o, lc, &lc->table[i]);
     }
-    fprintf(fptr, "\n");
+    out_char(&o, '\n');
+    out_end(&o);
 }
 
+#ifndef LEX_LIBRARY
 int main(int argc, char *argv[]) 
 {
-    fptr = fopen("tokens.txt","w");
+    FILE *fptr = fopen("tokens.txt","w");
     
     // file input handling
     if (argc != 2) 
@@ -289,15 +883,29 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    size_t bytesRead = fread(source, 1, MAX_SOURCE_SIZE-1, fp);
-    source[bytesRead] = '\0';  // null-terminate the string
+    // main program flow: tokens are written as soon as they are scanned,
+    // so memory use does not grow with the size of the source
+    lexContext lc;
+    lexStream ls;
+    lexeme lex;
+    outbuf o;
+    lexInit(&lc);
+    if (lexOpenFile(&ls, fp) < 0) 
+    {
+        fclose(fp);
+        return 1;
+    }
+    out_begin(&o, fptr);
+    while (nextLexeme(&lc, &ls, &lex)) 
+    {
+        outLexeme(&o, &lc, &lex);
+    }
+    out_char(&o, '\n');
+    out_end(&o);
+    lexClose(&ls);
+    lexFree(&lc);
     fclose(fp);
 
-    // main program flow
-    // printSource(source);
-    lexer(source);
-    // printLexemeTable();
-    printTokenList();
-
     return 0;
 }
+#endif
@@ -0,0 +1,149 @@
+/*
+    lex.h - Shared interface for the PL/0 lexical analyzer
+
+    Lets another program (parsercodegen.c) run the lexer in-process and
+    read its tokens straight out of memory instead of going through
+    tokens.txt.
+
+    To Compile (library mode, no main() in lex.c):
+        gcc -O2 -std=c11 -DLEX_LIBRARY -c lex.c
+*/
+
+#ifndef LEX_H
+#define LEX_H
+
+#include <stdio.h>
+#include "arena.h"
+
+#define MAX_ID_LEN 11
+#define MAX_NUM_LEN 5
+
+typedef enum 
+{
+    skipsym = 1, identsym, numbersym, plussym, minussym,
+    multsym, slashsym, eqlsym, neqsym,
+    lessym, leqsym, gtrsym, geqsym, lparentsym,
+    rparentsym, commasym, semicolonsym, periodsym, becomessym,
+    beginsym, endsym, ifsym, fisym, thensym, whilesym,
+    dosym, callsym, constsym, varsym, procsym,
+    writesym, readsym, elsesym, evensym
+} token_type;
+
+// One token as produced by lexer(); this is the in-memory token stream.
+// Tokens don't copy their text: it is source[offset, offset + length) of
+// the text they were lexed from (lexContext.source), and line/col
+// (1-based, col in bytes) is where it starts. For identsym, value is the
+// interned identifier ID (see identName); for numbersym, the number.
+// Tokens read back from tokens.txt have no source (all four are 0).
+typedef struct 
+{
+    int token;
+    int value;
+    int offset;
+    int length;
+    int line;
+    int col;
+} lexeme;
+
+// Per-compilation lexer state: the token stream and the interned
+// identifiers, all allocated from mem. Nothing in it is shared, so
+// separate contexts can lex on separate threads at the same time.
+typedef struct 
+{
+    arena mem;              // backs every table below; reset per compile
+    const char *source;     // text the tokens point into (lexer()/lexFile()), NULL if none
+    int sourceLen;
+    lexeme *table;          // token stream filled in by lexer()/lexFile(), grows as needed
+    int tableIndex;         // entries in table (only entries with token > 0 are real tokens)
+    int tableCapacity;
+    char *identText;        // null-terminated names, back to back
+    int identTextLen;
+    int identTextCap;
+    int *identOffset;       // identOffset[id] = start of name in identText
+    int identCount;
+    int identCap;
+    int *identSlots;        // open-addressing hash of (ID + 1), 0 meaning empty
+    int identSlotCount;     // power of two, kept at least twice identCount
+} lexContext;
+
+void lexInit(lexContext *lc);
+void lexFree(lexContext *lc);
+
+// Forget the previous compile's tokens and identifiers (one arena reset;
+// the memory is kept for the next compile)
+void lexReset(lexContext *lc);
+
+// Append an entry to lc->table and return it (for token readers)
+lexeme *newLexeme(lexContext *lc);
+// Append n uninitialized entries to lc->table and return the first
+lexeme *newLexemes(lexContext *lc, int n);
+
+// Interned identifiers: each distinct name gets a dense ID (0, 1, 2, ...)
+// shared by the lexer and the parser of one compilation
+int internIdent(lexContext *lc, const char *word, int len);
+const char *identName(const lexContext *lc, int id);
+
+// Bytes of source held in memory at once when streaming a file (./lex);
+// the token being scanned is kept in it, so it must exceed MAX_ID_LEN + 2
+#ifndef LEX_CHUNK_SIZE
+#define LEX_CHUNK_SIZE 65536
+#endif
+
+// Chunked reader over a source file or an in-memory string
+typedef struct 
+{
+    FILE *fp;           // NULL when lexing an in-memory string
+    const char *data;   // current window of source text
+    char *chunk;        // buffer backing data when reading fp
+    size_t len;         // bytes available in data
+    size_t pos;         // read position in data
+    size_t base;        // source offset of data[0]
+    size_t mark;        // start of the token being scanned; a refill keeps it
+    int line;           // line of the read position (1-based)
+    size_t lineStart;   // source offset where that line starts
+    int inComment;      // input ended inside a /* */ comment
+} lexStream;
+
+// Pick the whitespace/comment/identifier scanners (scalar, SSE2 or AVX2)
+// for this CPU; lexScanner names the choice. Called by lexOpen*(); a
+// multi-threaded program calls it once before starting its threads.
+void selectScanners();
+extern const char *lexScanner;
+
+void lexOpenString(lexStream *ls, const char *input);
+// Open input[start, end) as its own source: line 1, column 1 at start,
+// offsets still counted from input[0]; input[end] need not be '\0'
+void lexOpenRange(lexStream *ls, const char *input, size_t start, size_t end);
+// Move a string stream to input[pos], which is on line at column col
+void lexSeek(lexStream *ls, size_t pos, int line, int col);
+int lexOpenFile(lexStream *ls, FILE *fp);
+void lexClose(lexStream *ls);
+
+// Scan the next token from ls into out (identifiers are interned in lc);
+// returns 0 at end of input
+int nextLexeme(lexContext *lc, lexStream *ls, lexeme *out);
+
+// Skip the rest of a comment that is open at the read position (its "/*"
+// already consumed); sets ls->inComment if the input ends first
+void lexSkipComment(lexStream *ls);
+
+// Scan everything left in ls into lc->table
+void lexAll(lexContext *lc, lexStream *ls);
+
+// Scan a null-terminated PL/0 source into lc->table; the tokens point
+// into input, which must outlive them
+void lexer(lexContext *lc, const char *input);
+
+// Read a PL/0 source file into lc->mem and scan it into lc->table;
+// returns -1 if it can't be read
+int lexFile(lexContext *lc, const char *path);
+
+// Text of a token from lexer()/lexFile() (lex->length bytes, not
+// null-terminated), NULL if lc has no source
+const char *lexText(const lexContext *lc, const lexeme *lex);
+
+// Write one token / the whole table in the tokens.txt format (debug dump)
+void printLexeme(FILE *out, const lexContext *lc, const lexeme *lex);
+void printTokenList(FILE *out, const lexContext *lc);
+
+#endif
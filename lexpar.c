@@ -0,0 +1,359 @@
+/*
+    lexpar - Parallel lexer for large PL/0 sources
+
+    Lexes a source file on several threads and writes tokens.txt exactly
+    as ./lex does.
+
+    To Compile:
+        gcc -O2 -std=c11 -pthread -DLEX_LIBRARY -o lexpar lexpar.c lex.c
+
+    To Compile as a library (no main()):
+        gcc -O2 -std=c11 -pthread -DLEX_LIBRARY -DLEXPAR_LIBRARY -c lexpar.c lex.c
+
+    To Execute:
+        ./lexpar <input file> [threads]
+    where:
+        [threads] defaults to the number of online CPUs
+    Notes:
+    - The source is cut into one chunk per thread, each cut at a
+      whitespace byte. Whitespace is never part of a token or of a
+      comment's opening or closing pair, so nothing straddles a cut and
+      only one thing about the text before a chunk matters to it:
+      whether a comment is open there.
+    - Each thread lexes its chunk speculatively in both states: from
+      outside a comment (the whole chunk), and from inside one (skip to
+      the end of the comment, then lex until the first token that starts
+      where a token of the outside run starts; from there the runs agree,
+      so the rest is shared). Every thread uses its own lexContext.
+    - A serial pass then walks the chunks in order, picks each chunk's
+      state from how the previous one ended, works out line numbers and
+      columns and gives the chunk's identifiers their IDs in order of
+      first use, so they match lexer()'s. Finally the threads copy their
+      tokens into the result, renumbering identifiers and moving
+      positions from chunk-relative to absolute.
+    - Chunks are at least LEXPAR_MIN_CHUNK bytes, so small sources use
+      fewer threads; a stretch without whitespace longer than a chunk
+      just makes that chunk bigger.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "lexpar.h"
+
+struct lexChunk
+{
+    pthread_t thread;
+    const char *input;
+    size_t start, end;      // the chunk is input[start, end)
+    lexContext out;         // tokens lexed from outside a comment
+    lexContext in;          // tokens lexed from inside one, up to sync
+    int sync;               // first out token the inside run shares (out.tableIndex if none)
+    int outOpen, inOpen;    // each run ended inside a comment
+    int lines;              // newlines in the chunk
+    size_t lastLineStart;   // start of the chunk's last line (if lines > 0)
+
+    // filled in by the serial pass
+    int useIn;              // a comment is open at start
+    int lineBase;           // line the chunk starts on
+    int colShift;           // column of start, minus 1
+    int first;              // index of the chunk's first token in the result
+    int *outMap, *inMap;    // chunk identifier ID -> result ID
+    lexContext *result;
+};
+
+void lexParallelInit(lexParallel *lp, int threads)
+{
+    if (threads < 1) threads = 1;
+    lp->threads = threads;
+    lp->chunksUsed = 0;
+    lp->chunks = calloc((size_t)threads, sizeof(lexChunk));
+    if (!lp->chunks)
+    {
+        fprintf(stderr, "Error: out of memory for lexer threads\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        lexInit(&lp->chunks[i].out);
+        lexInit(&lp->chunks[i].in);
+    }
+}
+
+void lexParallelFree(lexParallel *lp)
+{
+    for (int i = 0; i < lp->threads; i++)
+    {
+        lexFree(&lp->chunks[i].out);
+        lexFree(&lp->chunks[i].in);
+    }
+    free(lp->chunks);
+    lp->chunks = NULL;
+    lp->threads = 0;
+}
+
+static int isSpaceByte(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// lex one chunk both ways
+static void *lexChunkRuns(void *arg)
+{
+    lexChunk *ch = arg;
+    lexStream ls;
+
+    lexReset(&ch->out);
+    lexOpenRange(&ls, ch->input, ch->start, ch->end);
+    lexAll(&ch->out, &ls);
+    ch->outOpen = ls.inComment;
+    ch->lines = ls.line - 1;
+    ch->lastLineStart = ls.lineStart;
+
+    lexReset(&ch->in);
+    ch->sync = ch->out.tableIndex;
+    ch->inOpen = ch->outOpen;
+    if (ch->start == 0) return NULL; // nothing can be open before the source
+
+    lexOpenRange(&ls, ch->input, ch->start, ch->end);
+    lexSkipComment(&ls);
+    const lexeme *outTokens = ch->out.table;
+    int count = ch->out.tableIndex, j = 0;
+    lexeme lex;
+    while (nextLexeme(&ch->in, &ls, &lex))
+    {
+        while (j < count && outTokens[j].offset < lex.offset) j++;
+        if (j < count && outTokens[j].offset == lex.offset)
+        {
+            ch->sync = j;
+            return NULL;
+        }
+        *newLexeme(&ch->in) = lex;
+    }
+    ch->inOpen = ls.inComment;
+    return NULL;
+}
+
+// result IDs for the identifiers in tokens[0, count) of lc, in order of
+// first use; map[id] < 0 marks IDs not seen yet
+static void mapIdents(lexContext *result, const lexContext *lc, const lexeme *tokens, int count, int *map)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (tokens[i].token != identsym || map[tokens[i].value] >= 0) continue;
+        const char *name = identName(lc, tokens[i].value);
+        map[tokens[i].value] = internIdent(result, name, (int)strlen(name));
+    }
+}
+
+static int *newMap(lexContext *lc)
+{
+    int *map = arena_alloc(&lc->mem, (size_t)(lc->identCount + 1) * sizeof(int));
+    if (!map)
+    {
+        fprintf(stderr, "Error: out of memory for lexer threads\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(map, 0xff, (size_t)lc->identCount * sizeof(int));
+    return map;
+}
+
+static lexeme *copyTokens(lexeme *dst, const lexeme *src, int count, const int *map, const lexChunk *ch)
+{
+    for (int i = 0; i < count; i++)
+    {
+        lexeme lex = src[i];
+        if (lex.token == identsym) lex.value = map[lex.value];
+        if (lex.line == 1) lex.col += ch->colShift;
+        lex.line += ch->lineBase - 1;
+        dst[i] = lex;
+    }
+    return dst + count;
+}
+
+// copy the chunk's tokens into the result
+static void *copyChunk(void *arg)
+{
+    lexChunk *ch = arg;
+    lexeme *dst = ch->result->table + ch->first;
+    int from = 0;
+    if (ch->useIn)
+    {
+        dst = copyTokens(dst, ch->in.table, ch->in.tableIndex, ch->inMap, ch);
+        from = ch->sync;
+    }
+    copyTokens(dst, ch->out.table + from, ch->out.tableIndex - from, ch->outMap, ch);
+    return NULL;
+}
+
+// run fn on every chunk, chunk 0 on the calling thread; -1 if a thread
+// could not be started (the ones that were are joined first)
+static int runChunks(lexParallel *lp, void *(*fn)(void *))
+{
+    int started = 1;
+    for (; started < lp->chunksUsed; started++)
+    {
+        if (pthread_create(&lp->chunks[started].thread, NULL, fn, &lp->chunks[started]) != 0) break;
+    }
+    if (started == lp->chunksUsed) fn(&lp->chunks[0]);
+    for (int i = 1; i < started; i++) pthread_join(lp->chunks[i].thread, NULL);
+    return started == lp->chunksUsed ? 0 : -1;
+}
+
+int lexerParallel(lexParallel *lp, lexContext *lc, const char *input)
+{
+    size_t len = strlen(input);
+    selectScanners(); // before any thread reads the scanner pointers
+
+    // cut at the first whitespace at or after each even split point
+    size_t minChunk = LEXPAR_MIN_CHUNK;
+    int want = lp->threads;
+    if ((size_t)want > len / minChunk) want = len / minChunk > 0 ? (int)(len / minChunk) : 1;
+    int n = 0;
+    size_t start = 0;
+    for (int i = 1; i <= want; i++)
+    {
+        size_t limit = i == want ? len : len / want * i;
+        if (i < want)
+        {
+            size_t next = i + 1 == want ? len : len / want * (i + 1);
+            while (limit < next && !isSpaceByte(input[limit])) limit++;
+            if (limit == next) continue; // no whitespace before the next split point
+        }
+        lexChunk *ch = &lp->chunks[n++];
+        ch->input = input;
+        ch->start = start;
+        ch->end = limit;
+        ch->result = lc;
+        start = limit;
+    }
+    lp->chunksUsed = n;
+    if (n == 1)
+    {
+        lexer(lc, input);
+        return 0;
+    }
+
+    if (runChunks(lp, lexChunkRuns) < 0)
+    {
+        lexer(lc, input);
+        return -1;
+    }
+
+    // pick each chunk's state, place its tokens and lines
+    lexReset(lc);
+    lc->source = input;
+    lc->sourceLen = (int)len;
+    int open = 0, total = 0, line = 1;
+    size_t lineStart = 0;
+    for (int i = 0; i < n; i++)
+    {
+        lexChunk *ch = &lp->chunks[i];
+        ch->useIn = open;
+        ch->first = total;
+        ch->lineBase = line;
+        ch->colShift = (int)(ch->start - lineStart);
+        if (ch->useIn)
+        {
+            total += ch->in.tableIndex + ch->out.tableIndex - ch->sync;
+            open = ch->sync < ch->out.tableIndex ? ch->outOpen : ch->inOpen;
+        }
+        else
+        {
+            total += ch->out.tableIndex;
+            open = ch->outOpen;
+        }
+        if (ch->lines > 0)
+        {
+            line += ch->lines;
+            lineStart = ch->lastLineStart;
+        }
+    }
+    newLexemes(lc, total);
+
+    // identifier IDs in order of first use across the chunks
+    for (int i = 0; i < n; i++)
+    {
+        lexChunk *ch = &lp->chunks[i];
+        ch->outMap = newMap(&ch->out);
+        if (ch->useIn)
+        {
+            ch->inMap = newMap(&ch->in);
+            mapIdents(lc, &ch->in, ch->in.table, ch->in.tableIndex, ch->inMap);
+            mapIdents(lc, &ch->out, ch->out.table + ch->sync, ch->out.tableIndex - ch->sync, ch->outMap);
+        }
+        else
+        {
+            // the chunk's own IDs are already in order of first use
+            for (int id = 0; id < ch->out.identCount; id++)
+            {
+                const char *name = identName(&ch->out, id);
+                ch->outMap[id] = internIdent(lc, name, (int)strlen(name));
+            }
+        }
+    }
+
+    if (runChunks(lp, copyChunk) < 0)
+    {
+        for (int i = 1; i < n; i++) copyChunk(&lp->chunks[i]);
+        copyChunk(&lp->chunks[0]);
+    }
+    return 0;
+}
+
+#ifndef LEXPAR_LIBRARY
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3)
+    {
+        printf("Usage: %s <sourcefile> [threads]\n", argv[0]);
+        return 1;
+    }
+    int threads = argc == 3 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    FILE *fp = fopen(argv[1], "rb");
+    if (!fp)
+    {
+        perror("File open error");
+        return 1;
+    }
+    size_t len = 0, cap = 1 << 16, n;
+    char *text = malloc(cap + 1);
+    while (text && (n = fread(text + len, 1, cap - len, fp)) > 0)
+    {
+        len += n;
+        if (len == cap) text = realloc(text, (cap *= 2) + 1);
+    }
+    fclose(fp);
+    if (!text)
+    {
+        fprintf(stderr, "Error: out of memory for source file\n");
+        return 1;
+    }
+    text[len] = '\0';
+
+    lexContext lc;
+    lexParallel lp;
+    lexInit(&lc);
+    lexParallelInit(&lp, threads);
+    lexerParallel(&lp, &lc, text);
+
+    FILE *fptr = fopen("tokens.txt", "w");
+    if (!fptr)
+    {
+        perror("tokens.txt");
+        return 1;
+    }
+    printTokenList(fptr, &lc);
+    fclose(fptr);
+
+    lexParallelFree(&lp);
+    lexFree(&lc);
+    free(text);
+    return 0;
+}
+#endif
@@ -0,0 +1,41 @@
+/*
+    lexpar.h - Parallel lexing of large PL/0 sources
+
+    Splits the source into one chunk per thread and lexes the chunks at
+    the same time. The result (tokens, positions and identifier IDs) is
+    exactly what lexer() produces for the same text.
+
+    To Compile (library mode, no main() in lexpar.c):
+        gcc -O2 -std=c11 -pthread -DLEX_LIBRARY -DLEXPAR_LIBRARY -c lexpar.c lex.c
+*/
+
+#ifndef LEXPAR_H
+#define LEXPAR_H
+
+#include "lex.h"
+
+// Sources smaller than this per thread use fewer threads
+#ifndef LEXPAR_MIN_CHUNK
+#define LEXPAR_MIN_CHUNK (64 * 1024)
+#endif
+
+typedef struct lexChunk lexChunk;
+
+// Per-thread chunk state, kept between calls so repeated compiles reuse
+// the memory
+typedef struct
+{
+    int threads;
+    lexChunk *chunks;
+    int chunksUsed;         // chunks the last call split the source into
+} lexParallel;
+
+void lexParallelInit(lexParallel *lp, int threads);
+void lexParallelFree(lexParallel *lp);
+
+// Scan a null-terminated PL/0 source into lc->table on lp->threads
+// threads; same contract as lexer(). Returns 0, or -1 if a thread could
+// not be started (lc is then filled by lexer() instead)
+int lexerParallel(lexParallel *lp, lexContext *lc, const char *input);
+
+#endif
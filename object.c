@@ -0,0 +1,303 @@
+/*
+    object - PM/0 binary object files (.pmo)
+
+    Writes and maps the format described in object.h, and converts
+    between it and the text elf.txt format.
+
+    To Compile:
+        gcc -O2 -std=c11 -DVM_LIBRARY -o object object.c vm.c jit.c
+    or as a library (no main()):
+        gcc -O2 -std=c11 -DOBJECT_LIBRARY -c object.c
+
+    To Execute:
+        ./object <elf.txt> <out.pmo>     text to object
+        ./object <in.pmo> <out.txt>      object to text
+        ./object --dump <in.pmo>         print header, code and symbols
+    Notes:
+    - parsercodegen --object <out.pmo> writes an object with the symbol
+      section filled from sym_table; text converted here has no symbols.
+    - ./vm runs .pmo files directly from the mapping.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "object.h"
+
+#define ALIGN4(n) (((n) + 3u) & ~3u)
+
+
+static int obj_pack(const instruction *in, uint32_t *word, int32_t *pool, uint32_t *pool_count) {
+    int op = in->op, m = in->m;
+    if (in->l < 0 || in->l > OBJ_L_MAX || op < LIT || op > LSTO) return -1;
+    if (m < OBJ_M_MIN || m > OBJ_M_MAX) {
+        // an LSTO whose literal needs the pool is stored as the plain LIT
+        if (op != LIT && op != LSTO) return -1;
+        pool[*pool_count] = m;
+        op = OBJ_LIT_POOL;
+        m = (int)(*pool_count)++;
+    }
+    *word = (uint32_t)op | (uint32_t)in->l << 4 | (uint32_t)m << 8;
+    return 0;
+}
+
+
+int obj_pack_code(const instruction *code, int count, uint32_t *words, int32_t *pool) {
+    uint32_t pool_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (obj_pack(&code[i], &words[i], pool, &pool_count) < 0) return -1;
+    }
+    return (int)pool_count;
+}
+
+
+int obj_write(const char *path, const instruction *code, int count,
+              const symbol *syms, int sym_count, const char *const *names) {
+    if (!syms) sym_count = 0;
+    uint32_t *words = malloc((size_t)count * sizeof(uint32_t) + 1);
+    int32_t *pool = malloc((size_t)count * sizeof(int32_t) + 1);
+    obj_symbol *osyms = malloc((size_t)sym_count * sizeof(obj_symbol) + 1);
+    uint32_t pool_count = 0, names_size = 0;
+    int status = -1;
+    FILE *fp = NULL;
+    if (!words || !pool || !osyms) {
+        fprintf(stderr, "Error: out of memory writing '%s'.\n", path);
+        goto out;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (obj_pack(&code[i], &words[i], pool, &pool_count) < 0) {
+            fprintf(stderr, "Error: instruction %d (%d %d %d) can't be encoded.\n", i, code[i].op, code[i].l, code[i].m);
+            goto out;
+        }
+    }
+    for (int i = 0; i < sym_count; i++) {
+        osyms[i].kind = syms[i].kind;
+        osyms[i].val = syms[i].val;
+        osyms[i].level = syms[i].level;
+        osyms[i].addr = syms[i].addr;
+        osyms[i].name = names_size;
+        names_size += (uint32_t)strlen(names[i]) + 1;
+    }
+
+    obj_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, OBJ_MAGIC, 4);
+    h.version = OBJ_VERSION;
+    h.flags = syms ? OBJ_HAS_SYMBOLS : 0;
+    h.byte_order = OBJ_BYTE_ORDER;
+    h.code_count = (uint32_t)count;
+    h.code_offset = ALIGN4((uint32_t)sizeof(h));
+    h.pool_count = pool_count;
+    h.pool_offset = h.code_offset + h.code_count * 4;
+    h.sym_count = (uint32_t)sym_count;
+    h.sym_offset = h.pool_offset + h.pool_count * 4;
+    h.names_size = names_size;
+    h.names_offset = h.sym_offset + h.sym_count * (uint32_t)sizeof(obj_symbol);
+
+    fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error: Could not open output file '%s'.\n", path);
+        goto out;
+    }
+    fwrite(&h, sizeof(h), 1, fp);
+    for (size_t pad = sizeof(h); pad < h.code_offset; pad++) fputc(0, fp);
+    fwrite(words, sizeof(uint32_t), (size_t)count, fp);
+    fwrite(pool, sizeof(int32_t), pool_count, fp);
+    fwrite(osyms, sizeof(obj_symbol), (size_t)sym_count, fp);
+    for (int i = 0; i < sym_count; i++) {
+        fwrite(names[i], 1, strlen(names[i]) + 1, fp);
+    }
+    status = ferror(fp) ? -1 : 0;
+    if (fclose(fp) != 0) status = -1;
+    if (status < 0) fprintf(stderr, "Error: Could not write '%s'.\n", path);
+
+out:
+    free(words);
+    free(pool);
+    free(osyms);
+    return status;
+}
+
+
+int obj_is_object(const char *path) {
+    char magic[4];
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    int is_object = fread(magic, 1, 4, fp) == 4 && memcmp(magic, OBJ_MAGIC, 4) == 0;
+    fclose(fp);
+    return is_object;
+}
+
+
+// a section of count items of size bytes at offset lies inside the file
+static int obj_section_ok(const obj_file *obj, uint32_t offset, uint32_t count, size_t size) {
+    return offset % 4 == 0 && offset <= obj->size && (obj->size - offset) / size >= count;
+}
+
+
+int obj_open(const char *path, obj_file *obj) {
+    memset(obj, 0, sizeof(*obj));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("File open error");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(obj_header)) {
+        fprintf(stderr, "Error: '%s' is not a PM/0 object file.\n", path);
+        close(fd);
+        return -1;
+    }
+    obj->size = (size_t)st.st_size;
+    obj->map = mmap(NULL, obj->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (obj->map == MAP_FAILED) {
+        perror("mmap");
+        obj->map = NULL;
+        return -1;
+    }
+
+    const obj_header *h = obj->map;
+    const char *base = obj->map;
+    const char *problem = NULL;
+    if (memcmp(h->magic, OBJ_MAGIC, 4) != 0) problem = "not a PM/0 object file";
+    else if (h->version != OBJ_VERSION) problem = "unsupported object version";
+    else if (h->byte_order != OBJ_BYTE_ORDER) problem = "written with a different byte order";
+    else if (!obj_section_ok(obj, h->code_offset, h->code_count, sizeof(uint32_t)) ||
+             !obj_section_ok(obj, h->pool_offset, h->pool_count, sizeof(int32_t)) ||
+             !obj_section_ok(obj, h->sym_offset, h->sym_count, sizeof(obj_symbol)) ||
+             !obj_section_ok(obj, h->names_offset, h->names_size, 1)) problem = "truncated or corrupt";
+    else if (h->code_count == 0 || h->code_count > INT32_MAX) problem = "no PM/0 code";
+    else if (h->names_size > 0 && base[h->names_offset + h->names_size - 1] != '\0') problem = "corrupt symbol names";
+    else {
+        const obj_symbol *syms = (const obj_symbol *)(base + h->sym_offset);
+        for (uint32_t i = 0; i < h->sym_count && !problem; i++) {
+            if (syms[i].name >= h->names_size) problem = "corrupt symbol names";
+        }
+    }
+    if (problem) {
+        fprintf(stderr, "Error: '%s': %s.\n", path, problem);
+        obj_close(obj);
+        return -1;
+    }
+
+    obj->header = h;
+    obj->code = (const uint32_t *)(base + h->code_offset);
+    obj->pool = (const int32_t *)(base + h->pool_offset);
+    obj->symbols = (h->flags & OBJ_HAS_SYMBOLS) ? (const obj_symbol *)(base + h->sym_offset) : NULL;
+    obj->names = base + h->names_offset;
+    return 0;
+}
+
+
+void obj_close(obj_file *obj) {
+    if (obj->map) munmap(obj->map, obj->size);
+    memset(obj, 0, sizeof(*obj));
+}
+
+
+int obj_read_code(const obj_file *obj, instruction **code) {
+    int count = (int)obj->header->code_count;
+    instruction *out = malloc((size_t)count * sizeof(instruction));
+    if (!out) {
+        fprintf(stderr, "Error: out of memory.\n");
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (obj_unpack(obj, i, &out[i]) < 0) {
+            fprintf(stderr, "Error: bad constant pool index at instruction %d.\n", i);
+            free(out);
+            return -1;
+        }
+    }
+    *code = out;
+    return count;
+}
+
+
+#ifndef OBJECT_LIBRARY
+#include "vm.h"
+#include "outbuf.h"
+
+int dump_object(const char *path) {
+    obj_file obj;
+    if (obj_open(path, &obj) < 0) return EXIT_FAILURE;
+    const obj_header *h = obj.header;
+    printf("%s: PM/0 object v%d, %u instructions, %u pool constants, %u symbols, %zu bytes\n",
+           path, h->version, h->code_count, h->pool_count, obj.symbols ? h->sym_count : 0, obj.size);
+
+    printf("\nLine\tOP\tL\tM\n");
+    const char *names[] = {"", "LIT", "OPR", "LOD", "STO", "CAL", "INC", "JMP", "JPC", "SYS", "LLOS", "LLOJ", "LSTO"};
+    for (int i = 0; i < (int)h->code_count; i++) {
+        instruction in;
+        if (obj_unpack(&obj, i, &in) < 0 || in.op < LIT || in.op > LSTO) {
+            printf("%d\t??\t%08x\n", i, obj.code[i]);
+            continue;
+        }
+        printf("%d\t%s\t%d\t%d\n", i, names[in.op], in.l, in.m);
+    }
+
+    if (obj.symbols) {
+        printf("\nKind | Name        | Value | Level | Address\n");
+        for (uint32_t i = 0; i < h->sym_count; i++) {
+            const obj_symbol *s = &obj.symbols[i];
+            printf("%4d | %11s | %5d | %5d | %5d\n", s->kind, obj.names + s->name, s->val, s->level, s->addr);
+        }
+    }
+    obj_close(&obj);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[1], "--dump") == 0) return dump_object(argv[2]);
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <elf.txt> <out.pmo> | <in.pmo> <out.txt> | --dump <in.pmo>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    instruction *code;
+    int count;
+    if (obj_is_object(argv[1])) {
+        obj_file obj;
+        if (obj_open(argv[1], &obj) < 0) return EXIT_FAILURE;
+        count = obj_read_code(&obj, &code);
+        obj_close(&obj);
+        if (count < 0) return EXIT_FAILURE;
+
+        FILE *fp = fopen(argv[2], "w");
+        if (!fp) {
+            fprintf(stderr, "Error: Could not open output file '%s'.\n", argv[2]);
+            free(code);
+            return EXIT_FAILURE;
+        }
+        outbuf o; // elf.txt lines, "%d %d %d\n"
+        out_begin(&o, fp);
+        for (int i = 0; i < count; i++) {
+            out_int(&o, code[i].op);
+            out_char(&o, ' ');
+            out_int(&o, code[i].l);
+            out_char(&o, ' ');
+            out_int(&o, code[i].m);
+            out_char(&o, '\n');
+        }
+        out_end(&o);
+        fclose(fp);
+    } else {
+        count = vm_load_text(argv[1], &code);
+        if (count < 0) return EXIT_FAILURE;
+        if (obj_write(argv[2], code, count, NULL, 0, NULL) < 0) {
+            free(code);
+            return EXIT_FAILURE;
+        }
+    }
+    free(code);
+    return EXIT_SUCCESS;
+}
+#endif
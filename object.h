@@ -0,0 +1,112 @@
+/*
+    object.h - Binary object format for compiled PM/0 code (.pmo)
+
+    A .pmo file is laid out so it can be mmap'd and executed in place:
+
+        obj_header                  fixed size, at offset 0
+        code    uint32_t[code_count]    one packed word per instruction
+        pool    int32_t[pool_count]     LIT values too wide for a word
+        symbols obj_symbol[sym_count]   optional (OBJ_HAS_SYMBOLS)
+        names   char[names_size]        NUL-terminated symbol names
+
+    Every section starts on a 4-byte boundary and is stored in the byte
+    order of the machine that wrote it (byte_order tells a reader whether
+    that matches its own).
+
+    Packed instruction word: bits 0-3 op, bits 4-7 L, bits 8-31 M as a
+    signed 24-bit value. A LIT whose value doesn't fit uses op
+    OBJ_LIT_POOL with M indexing the constant pool. Superinstruction
+    opcodes (parsercodegen --fuse) are packed like the others.
+*/
+
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "parsercodegen.h"
+
+#define OBJ_MAGIC "PM0O"
+#define OBJ_VERSION 1
+#define OBJ_BYTE_ORDER 0x01020304u
+
+// obj_header.flags
+#define OBJ_HAS_SYMBOLS 0x1
+
+// packed op for a LIT whose value lives in the constant pool
+#define OBJ_LIT_POOL 15
+
+#define OBJ_L_MAX 15
+#define OBJ_M_MIN (-(1 << 23))
+#define OBJ_M_MAX ((1 << 23) - 1)
+
+typedef struct {
+    char magic[4];          // OBJ_MAGIC, not NUL-terminated
+    uint16_t version;       // OBJ_VERSION
+    uint16_t flags;         // OBJ_HAS_SYMBOLS
+    uint32_t byte_order;    // OBJ_BYTE_ORDER as written by the producer
+    uint32_t code_count, code_offset;
+    uint32_t pool_count, pool_offset;
+    uint32_t sym_count, sym_offset;
+    uint32_t names_size, names_offset;
+} obj_header;
+
+typedef struct {
+    int32_t kind;           // enum symbol_kind
+    int32_t val;            // value for constants
+    int32_t level;          // scope level
+    int32_t addr;           // address for variables
+    uint32_t name;          // offset into the names section
+} obj_symbol;
+
+// A mapped object file; the section pointers point into the mapping
+typedef struct {
+    void *map;
+    size_t size;
+    const obj_header *header;
+    const uint32_t *code;
+    const int32_t *pool;
+    const obj_symbol *symbols;  // NULL without OBJ_HAS_SYMBOLS
+    const char *names;
+} obj_file;
+
+// Write code[0..count) to path; syms may be NULL (no symbol section),
+// otherwise names[i] is the name of syms[i]. Returns 0 or -1.
+int obj_write(const char *path, const instruction *code, int count,
+              const symbol *syms, int sym_count, const char *const *names);
+
+// 1 if path starts with OBJ_MAGIC, 0 otherwise
+int obj_is_object(const char *path);
+
+// mmap and validate an object file; returns 0 or -1 (with a message)
+int obj_open(const char *path, obj_file *obj);
+void obj_close(obj_file *obj);
+
+// Pack code[0..count) into words[0..count) and pool (room for count
+// entries); returns the number of pool entries used, or -1 if an
+// instruction can't be encoded
+int obj_pack_code(const instruction *code, int count, uint32_t *words, int32_t *pool);
+
+// Unpack one packed word whose pool is pool[0..pool_count); returns -1 if
+// its pool index is out of range
+static inline int obj_unpack_word(uint32_t word, const int32_t *pool, uint32_t pool_count, instruction *out) {
+    out->op = (int)(word & 0xF);
+    out->l = (int)((word >> 4) & 0xF);
+    out->m = (int32_t)word >> 8; // arithmetic shift sign-extends M
+    if (out->op == OBJ_LIT_POOL) {
+        if (out->m < 0 || (uint32_t)out->m >= pool_count) return -1;
+        out->op = LIT;
+        out->m = pool[out->m];
+    }
+    return 0;
+}
+
+// Unpack instruction i; returns -1 if its pool index is out of range
+static inline int obj_unpack(const obj_file *obj, int i, instruction *out) {
+    return obj_unpack_word(obj->code[i], obj->pool, obj->header->pool_count, out);
+}
+
+// Unpack all of the code into a malloc'd array; returns the count or -1
+int obj_read_code(const obj_file *obj, instruction **code);
+
+#endif
@@ -0,0 +1,307 @@
+/*
+    optimizer - Peephole and constant-folding pass for PM/0 code
+
+    Rewrites code[] produced by parsercodegen.c before it is written to
+    elf.txt. Repeats until nothing changes:
+        - folds LIT a, LIT b, OPR op and LIT a, OPR EVEN into one LIT
+        - drops identities (x+0, x-0, x*1, x/1) and rewrites x*0, 0*x,
+          0+x and 1*x when x is a single LOD
+        - resolves JPC on a constant, threads jumps to jumps, and drops
+          jumps to the next instruction
+        - removes code that can't be reached from instruction 0
+    then compacts the array and fixes every JMP/JPC/CAL target.
+
+    fuse_code() is separate and opt-in: it marks the sequences the VM
+    runs as one superinstruction (parsercodegen.h, enum fused_opcode).
+
+    Deleted instructions are marked with op NOP while optimizing; a jump
+    to a deleted instruction means the next live one.
+
+    To Compile (with the parser):
+        gcc -O2 -std=c11 -DLEX_LIBRARY -o parsercodegen parsercodegen.c lex.c optimizer.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "optimizer.h"
+
+#define NOP 0 // deleted instruction (not a PM/0 opcode)
+
+static int is_jump(const instruction *in) {
+    return in->op == JMP || in->op == JPC || in->op == CAL;
+}
+
+static int is_binary_opr(const instruction *in) {
+    return in->op == OPR && in->m >= ADD && in->m <= GEQ;
+}
+
+// next live instruction at or after i (count if none)
+static int live_from(const instruction *code, int count, int i) {
+    while (i < count && code[i].op == NOP) i++;
+    return i;
+}
+
+// live instruction a JMP/JPC/CAL operand lands on (count if past the end)
+static int target_of(const instruction *code, int count, int m) {
+    int i = CODE_INDEX(m);
+    if (i < 0 || i > count) i = count;
+    return live_from(code, count, i);
+}
+
+// evaluate a binary OPR on constants; returns 0 if it must be left to run time
+static int fold_binary(int opr, int a, int b, int *result) {
+    switch (opr) {
+        // wrap like the VM does instead of relying on signed overflow
+        case ADD: *result = (int)((unsigned)a + (unsigned)b); return 1;
+        case SUB: *result = (int)((unsigned)a - (unsigned)b); return 1;
+        case MUL: *result = (int)((unsigned)a * (unsigned)b); return 1;
+        case DIV:
+            if (b == 0) return 0; // keep the run-time error
+            *result = opr_div(a, b);
+            return 1;
+        case EQL: *result = a == b; return 1;
+        case NEQ: *result = a != b; return 1;
+        case LSS: *result = a < b; return 1;
+        case LEQ: *result = a <= b; return 1;
+        case GTR: *result = a > b; return 1;
+        case GEQ: *result = a >= b; return 1;
+    }
+    return 0;
+}
+
+static void set_instruction(instruction *in, int op, int l, int m) {
+    in->op = op;
+    in->l = l;
+    in->m = m;
+}
+
+// point every jump at a live instruction and mark jump targets
+static void mark_targets(instruction *code, int count, char *is_target) {
+    memset(is_target, 0, (size_t)count + 1);
+    for (int i = 0; i < count; i++) {
+        if (code[i].op == NOP || !is_jump(&code[i])) continue;
+        int t = target_of(code, count, code[i].m);
+        code[i].m = CODE_ADDR(t);
+        is_target[t] = 1;
+    }
+}
+
+// constant folding and algebraic identities; returns the number of rewrites
+static int fold_pass(instruction *code, int count, const char *is_target, opt_stats *stats) {
+    int changes = 0;
+    for (int i = live_from(code, count, 0); i < count; i = live_from(code, count, i + 1)) {
+        int j = live_from(code, count, i + 1);
+        if (j >= count || is_target[j]) continue;
+        instruction *a = &code[i], *b = &code[j];
+        int k = live_from(code, count, j + 1);
+        instruction *c = (k < count && !is_target[k]) ? &code[k] : NULL;
+        int value;
+
+        // LIT a, OPR EVEN -> LIT (a even)
+        if (a->op == LIT && b->op == OPR && b->m == EVEN) {
+            a->m = a->m % 2 == 0;
+            b->op = NOP;
+            stats->folded++;
+            changes++;
+            continue;
+        }
+        // LIT a, LIT b, OPR op -> LIT (a op b)
+        if (a->op == LIT && b->op == LIT && c && is_binary_opr(c) && fold_binary(c->m, a->m, b->m, &value)) {
+            a->m = value;
+            b->op = c->op = NOP;
+            stats->folded++;
+            changes++;
+            continue;
+        }
+        // x, LIT 0, OPR ADD/SUB and x, LIT 1, OPR MUL/DIV -> x
+        if (!is_target[i] && a->op == LIT && b->op == OPR &&
+            ((a->m == 0 && (b->m == ADD || b->m == SUB)) || (a->m == 1 && (b->m == MUL || b->m == DIV)))) {
+            a->op = b->op = NOP;
+            stats->identities++;
+            changes++;
+            continue;
+        }
+        if (!c || c->op != OPR) continue;
+        // LOD x, LIT 0, OPR MUL -> LIT 0
+        if (a->op == LOD && b->op == LIT && b->m == 0 && c->m == MUL) {
+            set_instruction(a, LIT, 0, 0);
+            b->op = c->op = NOP;
+            stats->identities++;
+            changes++;
+            continue;
+        }
+        // LIT 0, LOD x, OPR MUL -> LIT 0;  LIT 0, LOD x, OPR ADD -> LOD x;  LIT 1, LOD x, OPR MUL -> LOD x
+        if (a->op == LIT && b->op == LOD &&
+            ((a->m == 0 && (c->m == MUL || c->m == ADD)) || (a->m == 1 && c->m == MUL))) {
+            if (a->m == 0 && c->m == MUL) set_instruction(a, LIT, 0, 0);
+            else *a = *b;
+            b->op = c->op = NOP;
+            stats->identities++;
+            changes++;
+            continue;
+        }
+    }
+    return changes;
+}
+
+// constant conditions, jump threading, jumps to the next instruction
+static int branch_pass(instruction *code, int count, const char *is_target, opt_stats *stats) {
+    int changes = 0;
+    for (int i = live_from(code, count, 0); i < count; i = live_from(code, count, i + 1)) {
+        instruction *in = &code[i];
+
+        // LIT c, JPC t -> JMP t when c == 0, nothing otherwise
+        int j = live_from(code, count, i + 1);
+        if (in->op == LIT && j < count && code[j].op == JPC && !is_target[j]) {
+            if (in->m == 0) set_instruction(in, JMP, 0, code[j].m);
+            else in->op = NOP;
+            code[j].op = NOP;
+            stats->branches++;
+            changes++;
+            continue;
+        }
+
+        if (in->op != JMP && in->op != JPC) continue;
+
+        // follow chains of JMPs (bounded in case of a JMP cycle)
+        int t = target_of(code, count, in->m);
+        for (int hops = 0; t < count && code[t].op == JMP && hops < count; hops++) {
+            int next = target_of(code, count, code[t].m);
+            if (next == t) break;
+            t = next;
+        }
+        if (CODE_ADDR(t) != in->m) {
+            in->m = CODE_ADDR(t);
+            stats->branches++;
+            changes++;
+        }
+
+        // a JMP to the next live instruction does nothing (instruction 0 stays)
+        if (i > 0 && in->op == JMP && t == j) {
+            in->op = NOP;
+            stats->branches++;
+            changes++;
+        }
+    }
+    return changes;
+}
+
+// delete instructions that can't be reached from instruction 0
+static int dead_code_pass(instruction *code, int count, opt_stats *stats) {
+    char *reached = calloc((size_t)count + 1, 1);
+    int *work = malloc((size_t)(count + 1) * sizeof(int));
+    int top = 0, changes = 0;
+    if (!reached || !work) {
+        free(reached);
+        free(work);
+        return 0;
+    }
+
+    work[top++] = 0;
+    while (top > 0) {
+        int i = live_from(code, count, work[--top]);
+        while (i < count && !reached[i]) {
+            reached[i] = 1;
+            const instruction *in = &code[i];
+            if (is_jump(in)) work[top++] = target_of(code, count, in->m);
+            // no fall through after JMP, RTN, or halt
+            if (in->op == JMP || (in->op == OPR && in->m == RTN) || (in->op == SYS && in->m == SYS_HALT)) break;
+            i = live_from(code, count, i + 1);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (code[i].op != NOP && !reached[i]) {
+            code[i].op = NOP;
+            stats->dead++;
+            changes++;
+        }
+    }
+    free(reached);
+    free(work);
+    return changes;
+}
+
+int optimize_code(instruction *code, int count, opt_stats *stats) {
+    opt_stats local;
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+    stats->before = count;
+
+    char *is_target = malloc((size_t)count + 1);
+    int *new_index = malloc((size_t)(count + 1) * sizeof(int));
+    if (!is_target || !new_index) {
+        free(is_target);
+        free(new_index);
+        stats->after = count;
+        return count;
+    }
+
+    int changes;
+    do {
+        mark_targets(code, count, is_target);
+        changes = fold_pass(code, count, is_target, stats);
+        mark_targets(code, count, is_target);
+        changes += branch_pass(code, count, is_target, stats);
+        changes += dead_code_pass(code, count, stats);
+    } while (changes > 0);
+
+    // compact; a deleted instruction maps to the next live one
+    int out = 0;
+    for (int i = 0; i < count; i++) {
+        new_index[i] = out;
+        if (code[i].op != NOP) out++;
+    }
+    new_index[count] = out;
+    out = 0;
+    for (int i = 0; i < count; i++) {
+        if (code[i].op == NOP) continue;
+        if (is_jump(&code[i])) code[i].m = CODE_ADDR(new_index[target_of(code, count, code[i].m)]);
+        code[out++] = code[i];
+    }
+
+    free(is_target);
+    free(new_index);
+    stats->after = out;
+    return out;
+}
+
+
+// LOD 0 x, LIT c, OPR op at code[i]; returns op or -1
+static int load_literal_opr(const instruction *code, int count, int i) {
+    if (i + 3 >= count) return -1;
+    if (code[i].op != LOD || code[i].l != 0 || code[i + 1].op != LIT || code[i + 2].op != OPR) return -1;
+    return code[i + 2].m;
+}
+
+void fuse_code(instruction *code, int count, fuse_stats *stats) {
+    fuse_stats local;
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+
+    // a jump into the middle of a sequence has to find plain instructions there
+    char *is_target = calloc((size_t)count + 1, 1);
+    if (!is_target) return;
+    for (int i = 0; i < count; i++) {
+        if (is_jump(&code[i]) && code[i].m >= 0 && CODE_INDEX(code[i].m) <= count) is_target[CODE_INDEX(code[i].m)] = 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int opr = load_literal_opr(code, count, i), fused = 0;
+        if (opr >= ADD && opr <= MUL && code[i + 3].op == STO && code[i + 3].l == 0) fused = LLOS;
+        else if (opr >= EQL && opr <= GEQ && code[i + 3].op == JPC) fused = LLOJ;
+        else if (i + 1 < count && code[i].op == LIT && code[i + 1].op == STO && code[i + 1].l == 0) fused = LSTO;
+        if (!fused) continue;
+
+        int length = FUSED_LENGTH(fused), inside = 0;
+        for (int k = 1; k < length; k++) inside |= is_target[i + k];
+        if (inside) continue;
+        if (fused == LLOS) stats->llos++;
+        else if (fused == LLOJ) stats->lloj++;
+        else stats->lsto++;
+        code[i].op = fused;
+        i += length - 1;
+    }
+    free(is_target);
+}
@@ -0,0 +1,37 @@
+/*
+    optimizer.h - Peephole / constant-folding pass over PM/0 code[]
+
+    Runs between parsing and write_code_to_file() (parsercodegen
+    --optimize), followed by superinstruction fusion (--fuse).
+*/
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "parsercodegen.h"
+
+typedef struct {
+    int before;      // instructions in
+    int after;       // instructions out
+    int folded;      // constant subexpressions folded
+    int identities;  // x+0, x-0, x*1, x/1, x*0, 0+x, 1*x, 0*x simplified
+    int branches;    // constant JPCs resolved, jumps threaded or removed
+    int dead;        // unreachable instructions removed
+} opt_stats;
+
+// Optimize code[0..count) in place; returns the new instruction count.
+// Instruction 0 (the JMP 0 3 entry) is always kept. stats may be NULL.
+int optimize_code(instruction *code, int count, opt_stats *stats);
+
+typedef struct {
+    int llos;        // LOD, LIT, OPR ADD/SUB/MUL, STO fused
+    int lloj;        // LOD, LIT, OPR <rel>, JPC fused
+    int lsto;        // LIT, STO fused
+} fuse_stats;
+
+// Turn the first instruction of each fusable sequence into its
+// superinstruction (enum fused_opcode); nothing moves and the count is
+// unchanged. Run it last: the other passes only know plain PM/0.
+void fuse_code(instruction *code, int count, fuse_stats *stats);
+
+#endif
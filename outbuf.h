@@ -0,0 +1,169 @@
+/*
+    outbuf.h - Buffered writer for the text outputs (elf.txt, tokens.txt,
+    listings)
+
+    Formats integers and strings straight into a 64 KB buffer, with no
+    format string to parse, and hands each full buffer to the file with a
+    single write(2) (fwrite() when the stream has no descriptor, e.g. a
+    memory stream, or on Windows). The bytes written are the same as the
+    printf() conversions each function names.
+
+    Usage: out_begin() on a FILE (flushes what stdio holds for it), any
+    number of out_*() calls, then out_end(); stdio may be used on the
+    stream again afterwards. The buffer is inside the outbuf, so an
+    outbuf on the stack costs no allocation and each thread has its own.
+
+    Header-only, so every program that includes it builds unchanged.
+*/
+
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stdio.h>
+#include <string.h>
+#if !defined(_WIN32)
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+#define OUTBUF_SIZE ((size_t)1 << 16)
+
+typedef struct {
+    FILE *fp;
+    int fd;                     // -1: write through fp
+    int error;                  // a write failed
+    size_t len;                 // bytes waiting in buf
+    char buf[OUTBUF_SIZE];
+} outbuf;
+
+static inline void out_write(outbuf *o, const char *data, size_t n) {
+#if !defined(_WIN32)
+    if (o->fd >= 0) {
+        while (n > 0) {
+            ssize_t done = write(o->fd, data, n);
+            if (done < 0 && errno == EINTR) continue;
+            if (done <= 0) {
+                o->error = 1;
+                return;
+            }
+            data += done;
+            n -= (size_t)done;
+        }
+        return;
+    }
+#endif
+    if (fwrite(data, 1, n, o->fp) != n) o->error = 1;
+}
+
+static inline void out_flush(outbuf *o) {
+    if (o->len) out_write(o, o->buf, o->len);
+    o->len = 0;
+}
+
+static inline void out_begin(outbuf *o, FILE *fp) {
+    fflush(fp);
+    o->fp = fp;
+#if !defined(_WIN32)
+    o->fd = fileno(fp);
+#else
+    o->fd = -1;
+#endif
+    o->error = 0;
+    o->len = 0;
+}
+
+// flush the buffer; returns 0, or -1 if any write failed
+static inline int out_end(outbuf *o) {
+    out_flush(o);
+    if (o->fd < 0) fflush(o->fp);
+    return o->error ? -1 : 0;
+}
+
+// make room for n more bytes (n <= OUTBUF_SIZE)
+static inline char *out_room(outbuf *o, size_t n) {
+    if (o->len + n > OUTBUF_SIZE) out_flush(o);
+    return o->buf + o->len;
+}
+
+static inline void out_char(outbuf *o, char c) {
+    *out_room(o, 1) = c;
+    o->len++;
+}
+
+static inline void out_bytes(outbuf *o, const char *s, size_t n) {
+    if (n > OUTBUF_SIZE / 2) {
+        out_flush(o);
+        out_write(o, s, n);
+        return;
+    }
+    memcpy(out_room(o, n), s, n);
+    o->len += n;
+}
+
+// "%s"
+static inline void out_str(outbuf *o, const char *s) {
+    out_bytes(o, s, strlen(s));
+}
+
+static inline void out_pad(outbuf *o, char c, int n) {
+    for (; n > 0; n--) out_char(o, c);
+}
+
+// "%-<width>s"
+static inline void out_str_left(outbuf *o, const char *s, int width) {
+    size_t n = strlen(s);
+    out_bytes(o, s, n);
+    out_pad(o, ' ', width - (int)n);
+}
+
+// the decimal digits of v, written backwards ending at end; returns the
+// first digit. Two digits per division.
+static inline char *out_digits(char *end, unsigned v) {
+    static const char pairs[201] =
+        "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+        "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+    while (v >= 100) {
+        unsigned r = v % 100;
+        v /= 100;
+        end -= 2;
+        memcpy(end, pairs + 2 * r, 2);
+    }
+    if (v >= 10) {
+        end -= 2;
+        memcpy(end, pairs + 2 * v, 2);
+    } else {
+        *--end = (char)('0' + v);
+    }
+    return end;
+}
+
+// "%<width>d" with pad ' ', "%0<width>d" with pad '0'
+static inline void out_int_pad(outbuf *o, int v, int width, char pad) {
+    char tmp[12];
+    char *end = tmp + sizeof(tmp);
+    char *s = out_digits(end, v < 0 ? 0u - (unsigned)v : (unsigned)v);
+    if (v < 0 && pad == '0') {
+        out_char(o, '-'); // the zeros go after the sign
+        out_pad(o, '0', width - (int)(end - s) - 1);
+    } else {
+        if (v < 0) *--s = '-';
+        out_pad(o, pad, width - (int)(end - s));
+    }
+    size_t n = (size_t)(end - s);
+    memcpy(out_room(o, n), s, n);
+    o->len += n;
+}
+
+// "%d"
+static inline void out_int(outbuf *o, int v) {
+    char *p = out_room(o, 11);
+    char tmp[12];
+    char *end = tmp + sizeof(tmp);
+    char *s = out_digits(end, v < 0 ? 0u - (unsigned)v : (unsigned)v);
+    if (v < 0) *--s = '-';
+    size_t n = (size_t)(end - s);
+    memcpy(p, s, n);
+    o->len += n;
+}
+
+#endif
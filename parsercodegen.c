@@ -8,19 +8,49 @@
     To Compile:
         Scanner:
             gcc -O2 -std=c11 -o lex lex.c
-        Parser/Code Generator:
-            gcc -O2 -std=c11 -o parsercodegen parsercodegen.c
+        Parser/Code Generator (links the lexer in library mode):
+            gcc -O2 -std=c11 -DLEX_LIBRARY -DOBJECT_LIBRARY -o parsercodegen parsercodegen.c lex.c optimizer.c object.c ir.c
     To Execute (on Eustis):
         ./lex <input_file.txt>
-        ./parsercodegen
+        ./parsercodegen [--ir] [--dump-ir] [--optimize] [--fuse] [--object <out.pmo>] [--stats[=json]]
+                        [--all-errors]
+    or, lexing in-process without the tokens.txt round trip:
+        ./parsercodegen <input_file.txt> [--dump-tokens] [--ir] [--dump-ir] [--optimize] [--fuse] [--object <out.pmo>] [--stats[=json]]
+                        [--all-errors]
 
     where:
         <input_file.txt> is the path to the PL/0 source program
     Notes:
         - lex.c accepts ONE command-line argument (input PL/0 source file)
-        - parsercodegen.c accepts NO command-line arguments
-        - Input filename is hard-coded in parsercodegen.c
-        - Implements recursive-descent parser for PL/0 grammar
+        - parsercodegen.c with NO arguments reads the hard-coded tokens.txt
+          (mmap'd and scanned in one pass, see read_token_file())
+        - parsercodegen.c given a source file runs lexer() in-process and
+          parses its token table directly; --dump-tokens also writes
+          tokens.txt for debugging
+        - --ir lifts code[] into ir.c's three-address IR, runs value
+          numbering over its control-flow graph (common subexpressions,
+          redundant loads and stores, constants) and lowers it back;
+          --dump-ir also writes the optimized IR to ir.txt
+        - --optimize runs optimizer.c (constant folding, peephole, dead
+          code) over code[] before it is printed and written (after --ir)
+        - --fuse then marks superinstructions (LLOS, LLOJ, LSTO; see
+          parsercodegen.h) that ./vm runs in one dispatch each; without it
+          the output is plain PM/0
+        - --object also writes the code and symbol table as a binary
+          object file (object.h) that ./vm can run directly
+        - --all-errors keeps parsing after an error (skipping to the end
+          of the statement or declaration) and reports every error found,
+          each with its line and column (its token number when reading
+          tokens.txt), then the count; no code is written
+        - --stats prints the time of each phase (file read, lexer() or
+          read_token_list(), program(), write_code_to_file(), ...) and the
+          compile's counters to stderr; --stats=json prints them as one
+          JSON object for CI to track
+        - Implements recursive-descent parser for PL/0 grammar, with
+          nested procedures ("procedure p; block;" after the var
+          declarations, "call p"): a procedure's block is one level
+          deeper, ends with RTN, and sees the enclosing blocks' names
+          through LOD/STO/CAL L = the difference in levels
         - Generates PM/0 assembly code (see Appendix A for ISA)
         - All development and testing performed on Eustis
 
@@ -31,631 +61,1408 @@
     Due Date: Friday, October 31, 2025 at 11:59 PM ET
 */
 
+#define _POSIX_C_SOURCE 200809L // clock_gettime for --stats
+
 // Libraries
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "parsercodegen.h"
+#include "optimizer.h"
+#include "object.h"
+#include "ir.h"
+#include "outbuf.h"
 
 // Constants
-#define MAX_SYMBOL_TABLE_SIZE 500
-#define MAX_CODE_LENGTH 1000
-#define MAX_TOKENS 1000
 #define MAX_IDENT_LEN 12
-#define MAX_NUMBER_LEN 5
 #define TOKEN_FILENAME "tokens.txt"
+#define IR_FILENAME "ir.txt"
 #define CODE_FILENAME "elf.txt"
 
-// Enum Definitions
-enum token_type {
-    skipsym = 1, identsym, numbersym, plussym, minussym,
-    multsym, slashsym, eqlsym, neqsym,
-    lessym, leqsym, gtrsym, geqsym, lparentsym,
-    rparentsym, commasym, semicolonsym, periodsym, becomessym,
-    beginsym, endsym, ifsym, fisym, thensym, whilesym,
-    dosym, callsym, constsym, varsym, procsym,
-    writesym, readsym, elsesym, evensym
-};
-
-enum opcode {
-    LIT = 1, OPR, LOD, STO, CAL, INC, JMP, JPC, SYS
-};
-
-enum symbol_kind {
-    CONSTANT = 1, VARIABLE = 2
-};
-
-// Struct Definitions
-typedef struct {
-    int kind;        // const = 1, var = 2
-    char name[MAX_IDENT_LEN];   // symbol name
-    int val;         // value for constants
-    int level;       // scope level
-    int addr;        // address
-    int mark;        // marked for deletion
-} symbol;
-
-typedef struct {
-    int op;          // operation code
-    int l;           // lexicographical level
-    int m;           // modifier
-} instruction;
+// Function Prototypes
+int read_token_list(lexContext *lc);
+void advance_token(parser_ctx *p);
+void emit(parser_ctx *p, int op, int l, int m);
+void error(parser_ctx *p, int code);
+void mark_all_symbols(parser_ctx *p);
+void program(parser_ctx *p);
+void block(parser_ctx *p, int level, int *data_size);
+int block_head(parser_ctx *p, int level, int *data_size);
+void const_declaration(parser_ctx *p, int level);
+void var_declaration(parser_ctx *p, int level, int *data_size);
+void proc_declaration(parser_ctx *p, int level);
+void statement(parser_ctx *p, int level);
+void parse_statement(parser_ctx *p, int level);
+void skip_statement(parser_ctx *p, int start);
+void declarations(parser_ctx *p, int level, int *data_size);
+void skip_declaration(parser_ctx *p);
+void add_diagnostic(parser_ctx *p, int code, int token);
+void report_error(parser_ctx *p, int code);
+void soft_error(parser_ctx *p, int code);
+void missing_closer(parser_ctx *p, int code);
+void condition(parser_ctx *p, int level);
+void expression(parser_ctx *p, int level);
+void term(parser_ctx *p, int level);
+void factor(parser_ctx *p, int level);
+
+
+// isspace() in the C locale, as fscanf() skips it
+static int token_space(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
 
-typedef struct {
-    int type;        // token type
-    char name[MAX_IDENT_LEN];   // identifier name or number string
-    int value;       // numeric value
-} token;
-
-// Global Variables
-instruction code[MAX_CODE_LENGTH];
-symbol sym_table[MAX_SYMBOL_TABLE_SIZE];
-
-int code_index = 0; // Next available code index
-int sym_index = 0;  // Next available symbol table index
-int token_list[10000]; // Array to hold all tokens
-char token_lexeme[10000][MAX_IDENT_LEN]; // Array to hold lexemes/values
-int token_count = 0; // Total tokens read
-int token_ptr = 0;   // Current token index
-int error_flag = 0;  // Flag to indicate an error has occurred
-FILE *code_file;     // File pointer for elf.txt
-
-// The current token's ID, lexeme/value, and numeric value (if applicable)
-int current_token;
-char current_lexeme[MAX_IDENT_LEN];
-int current_number_val; // For numbersym
 
-// Function Prototypes
-void read_token_list();
-void advance_token();
-void emit(int op, int l, int m);
-void error(int code);
-int find_symbol(const char *name, int kind);
-int add_symbol(int kind, const char *name, int val, int level, int addr);
-void print_assembly_code();
-void print_symbol_table();
-void mark_all_symbols();
-void block(int level, int *data_size);
-void const_declaration(int level);
-void var_declaration(int level, int *data_size);
-void statement(int level);
-void condition(int level);
-void expression(int level);
-void term(int level);
-void factor(int level);
-
-
-// Load tokens from "tokens.txt" into tokenList
-void read_token_list()
-{
-    FILE *fp = fopen(TOKEN_FILENAME, "r");
-    if (!fp) {
-        fprintf(stderr, "Error: Could not open input file '%s'. Ensure 'lex.c' was run successfully.\n", TOKEN_FILENAME);
-        exit(EXIT_FAILURE);
+// fscanf("%d") over text[*pos, end): skips whitespace, reads an optional
+// sign and the digits (saturating like strtol(), then narrowed to int).
+// Returns 0 if there are no digits.
+static int scan_token_int(const char **pos, const char *end, int *out) {
+    const char *p = *pos;
+    while (p < end && token_space(*p)) p++;
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    if (p == end || *p < '0' || *p > '9') return 0;
+
+    unsigned long limit = negative ? (unsigned long)LONG_MAX + 1 : (unsigned long)LONG_MAX;
+    unsigned long v = 0;
+    int saturated = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        unsigned digit = (unsigned)(*p - '0');
+        if (v > (limit - digit) / 10) saturated = 1;
+        else v = v * 10 + digit;
     }
+    if (saturated) v = limit;
+    *out = (int)(negative ? (long)(0 - v) : (long)v);
+    *pos = p;
+    return 1;
+}
+
 
-    token_count = 0;
+// fscanf("%11s"): the next word, or its first MAX_IDENT_LEN - 1 bytes (the
+// rest is left for the next read); returns its length, 0 at end of input
+static int scan_token_word(const char **pos, const char *end, char *word) {
+    const char *p = *pos;
+    while (p < end && token_space(*p)) p++;
+    int len = 0;
+    while (p < end && len < MAX_IDENT_LEN - 1 && !token_space(*p)) word[len++] = *p++;
+    word[len] = '\0';
+    *pos = p;
+    return len;
+}
 
-    // Loop until we can't read another token ID
-    while (fscanf(fp, "%d", &token_list[token_count]) == 1) {
-        int token_id = token_list[token_count];
-        token_lexeme[token_count][0] = '\0'; // initialize
+
+int read_token_file(lexContext *lc, const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    lexReset(lc);
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        close(fd);
+        return 0;
+    }
+    const char *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED) return -1;
+
+    // one pass, with the same results as fscanf() token by token
+    const char *pos = text, *end = text + size;
+    int token_id;
+    while (scan_token_int(&pos, end, &token_id)) {
+        lexeme *tok = newLexeme(lc);
+        tok->token = token_id;
 
         if (token_id == identsym) {
-            if (fscanf(fp, "%s", token_lexeme[token_count]) != 1) {
-                fprintf(stderr, "Error: Expected identifier after identsym at token %d\n", token_count);
+            char name[MAX_IDENT_LEN];
+            if (scan_token_word(&pos, end, name) == 0) {
+                fprintf(stderr, "Error: Expected identifier after identsym at token %d\n", lc->tableIndex - 1);
+                lc->tableIndex--;
                 break;
             }
+            tok->value = internIdent(lc, name, (int)strlen(name));
         }
         else if (token_id == numbersym) {
-            int num_val;
-            if (fscanf(fp, "%d", &num_val) != 1) {
-                fprintf(stderr, "Error: Expected number after numbersym at token %d\n", token_count);
+            if (!scan_token_int(&pos, end, &tok->value)) {
+                fprintf(stderr, "Error: Expected number after numbersym at token %d\n", lc->tableIndex - 1);
+                lc->tableIndex--;
                 break;
             }
-            snprintf(token_lexeme[token_count], MAX_IDENT_LEN, "%d", num_val);
         }
-
-        token_count++;
-        if (token_count >= MAX_TOKENS) break;
     }
 
-    fclose(fp);
+    munmap((void *)text, size);
+    return lc->tableIndex;
+}
+
+
+// Load tokens from "tokens.txt" into lc->table (identifiers interned in lc);
+// returns the number of tokens read
+int read_token_list(lexContext *lc)
+{
+    int count = read_token_file(lc, TOKEN_FILENAME);
+    if (count < 0) {
+        fprintf(stderr, "Error: Could not open input file '%s'. Ensure 'lex.c' was run successfully.\n", TOKEN_FILENAME);
+        exit(EXIT_FAILURE);
+    }
+    return count;
 }
 
 
 // Advance to the next token in the token list
-void advance_token() {
-    if (error_flag) return;
+void advance_token(parser_ctx *p) {
+    if (p->error_flag && !p->recover) return;
 
-    if (token_ptr < token_count) {
-        current_token = token_list[token_ptr];
-        
-        if (current_token == skipsym) {
-            error_flag = 1;
-            error(1);
-            return;
+    for (;;) {
+        // lexer error entries (token <= 0) never reach tokens.txt, so skip them here too
+        while (p->token_ptr < p->token_count && p->token_list[p->token_ptr].token <= 0) {
+            p->token_ptr++;
         }
+        // recovering, a skipsym is reported and read past; the error its
+        // absence causes at the next token isn't
+        if (!p->recover || p->token_ptr >= p->token_count || p->token_list[p->token_ptr].token != skipsym) break;
+        add_diagnostic(p, 1, p->token_ptr++);
+        p->last_error_token = p->token_ptr;
+        if (!p->error_msg) p->error_msg = error_message(1);
+        p->error_flag = 1;
+    }
 
-        strncpy(current_lexeme, token_lexeme[token_ptr], MAX_IDENT_LEN);
-        current_lexeme[MAX_IDENT_LEN-1] = '\0';
+    if (p->token_ptr < p->token_count) {
+        p->current_token = p->token_list[p->token_ptr].token;
+        
+        if (p->current_token == skipsym) {
+            p->error_flag = 1;
+            error(p, 1);
+        }
 
-        if (current_token == numbersym) {
-            current_number_val = atoi(current_lexeme);
+        if (p->current_token == identsym) {
+            p->current_ident = p->token_list[p->token_ptr].value;
+            p->current_number_val = 0;
+        } else if (p->current_token == numbersym) {
+            p->current_ident = -1;
+            p->current_number_val = p->token_list[p->token_ptr].value;
         } else {
-            current_number_val = 0;
+            p->current_ident = -1;
+            p->current_number_val = 0;
         }
 
-        token_ptr++;
+        p->token_ptr++;
     } else {
-        current_token = skipsym;
-        strcpy(current_lexeme, "");
-        current_number_val = 0;
+        p->current_token = skipsym;
+        p->current_ident = -1;
+        p->current_number_val = 0;
     }
 }
-// Error handling function
-void error(int code) {
-    if (error_flag) return;
-    error_flag = 1;
-    char *msg;
+// message for a parser error code
+const char *error_message(int code) {
     switch (code) {
-        case 1:  msg = "Error: Scanning error detected by lexer (skipsym present)"; break; // lexer error
-        case 2:  msg = "Error: const, var, and read keywords must be followed by identifier"; break; // identifier expected
-        case 3:  msg = "Error: symbol name has already been declared"; break; // duplicate symbol
-        case 4:  msg = "Error: constants must be assigned with ="; break; // '=' expected
-        case 5:  msg = "Error: constants must be assigned an integer value"; break; // number expected
-        case 6:  msg = "Error: constant and variable declarations must be followed by a semicolon"; break; // semicolon expected
-        case 7:  msg = "Error: undeclared identifier"; break; // undeclared identifier
-        case 8:  msg = "Error: only variable values may be altered"; break; // assignment to non-variable
-        case 9:  msg = "Error: assignment statements must use :="; break;// ':=' expected
-        case 10: msg = "Error: begin must be followed by end"; break;// 'end' expected
-        case 11: msg = "Error: if must be followed by then"; break;// 'then' expected
-        case 12: msg = "Error: while must be followed by do"; break;// 'do' expected
-        case 13: msg = "Error: condition must contain comparison operator"; break;// relational operator expected
-        case 14: msg = "Error: right parenthesis must follow left parenthesis"; break;// ')' expected
-        case 15: msg = "Error: arithmetic equations must contain operands, parentheses, numbers, or symbols"; break;// factor expected
-        case 16: msg = "Error: program must end with period"; break;// '.' expected
-        case 32: msg = "Error: if must be followed by fi"; break;// 'fi' expected
-        default: msg = "Error: Unknown error occurred"; break;// unknown error
-    }
-
-    fprintf(stderr, "%s\n", msg);// Print to stderr
-    fprintf(code_file, "%s\n", msg);// Print to elf.txt
-    fclose(code_file);// Close output file
-    exit(EXIT_SUCCESS);
+        case 1:  return "Error: Scanning error detected by lexer (skipsym present)"; // lexer error
+        case 2:  return "Error: const, var, and read keywords must be followed by identifier"; // identifier expected
+        case 3:  return "Error: symbol name has already been declared"; // duplicate symbol
+        case 4:  return "Error: constants must be assigned with ="; // '=' expected
+        case 5:  return "Error: constants must be assigned an integer value"; // number expected
+        case 6:  return "Error: constant and variable declarations must be followed by a semicolon"; // semicolon expected
+        case 7:  return "Error: undeclared identifier"; // undeclared identifier
+        case 8:  return "Error: only variable values may be altered"; // assignment to non-variable
+        case 9:  return "Error: assignment statements must use :="; // ':=' expected
+        case 10: return "Error: begin must be followed by end"; // 'end' expected
+        case 11: return "Error: if must be followed by then"; // 'then' expected
+        case 12: return "Error: while must be followed by do"; // 'do' expected
+        case 13: return "Error: condition must contain comparison operator"; // relational operator expected
+        case 14: return "Error: right parenthesis must follow left parenthesis"; // ')' expected
+        case 15: return "Error: arithmetic equations must contain operands, parentheses, numbers, or symbols"; // factor expected
+        case 16: return "Error: program must end with period"; // '.' expected
+        case 17: return "Error: procedure and call keywords must be followed by identifier"; // identifier expected
+        case 18: return "Error: procedure declarations must be followed by a semicolon"; // semicolon expected
+        case 19: return "Error: call statements may only target procedures"; // call of a non-procedure
+        case 20: return "Error: procedures may not be used in arithmetic"; // procedure in an expression
+        case 32: return "Error: if must be followed by fi"; // 'fi' expected
+        default: return "Error: Unknown error occurred"; // unknown error
+    }
+}
+
+// Error handling function: records the first error and abandons the
+// compile by jumping back to parse_program(). A lexer error (skipsym)
+// sets error_flag first, so it stops the compile without a message.
+// Recovering, every error is recorded and the jump goes to the
+// innermost statement or declaration section instead.
+void error(parser_ctx *p, int code) {
+    if (p->recover) {
+        report_error(p, code);
+    } else if (!p->error_flag) {
+        p->error_msg = error_message(code);
+    }
+    p->error_flag = 1;
+    longjmp(p->on_error, 1);
+}
+
+// Recovering: record an error at the current token (the end of input
+// if there are no more tokens), once per token
+void report_error(parser_ctx *p, int code) {
+    int token = p->current_token == skipsym ? p->token_count : p->token_ptr - 1;
+    if (token != p->last_error_token) add_diagnostic(p, code, token);
+    p->last_error_token = token;
+    if (!p->error_msg) p->error_msg = error_message(code);
+    p->error_flag = 1;
+}
+
+// An error the parser can go on from where it is: recovering, report it
+// and carry on; otherwise error()
+void soft_error(parser_ctx *p, int code) {
+    if (p->recover) {
+        report_error(p, code);
+        return;
+    }
+    error(p, code);
+}
+
+// A missing fi or end: recovering, if the current token could follow
+// the statement anyway (; end fi . or the end of input), report it and
+// carry on as if it were there, so the rest of the block still parses.
+// Anything else is error().
+void missing_closer(parser_ctx *p, int code) {
+    int t = p->current_token;
+    if (p->recover && (t == semicolonsym || t == endsym || t == fisym || t == periodsym || t == skipsym)) {
+        report_error(p, code);
+        return;
+    }
+    error(p, code);
+}
+
+
+// add an error to p->diags
+void add_diagnostic(parser_ctx *p, int code, int token) {
+    if (p->diag_count >= p->diag_capacity) {
+        int new_capacity = p->diag_capacity ? p->diag_capacity * 2 : 64;
+        p->diags = arena_grow(&p->mem, p->diags, (size_t)p->diag_capacity * sizeof(diagnostic),
+                              (size_t)new_capacity * sizeof(diagnostic));
+        if (!p->diags) {
+            fprintf(stderr, "Error: out of memory for diagnostics.\n");
+            exit(EXIT_FAILURE);
+        }
+        p->diag_capacity = new_capacity;
+    }
+    p->diags[p->diag_count].code = code;
+    p->diags[p->diag_count].token = token;
+    p->diag_count++;
 }
 
 // function to emit instructions
-void emit(int op, int l, int m) {
-    if (code_index >= MAX_CODE_LENGTH) {
-        fprintf(stderr, "Error: Code array overflow.\n");
-        exit(EXIT_FAILURE);
+void emit(parser_ctx *p, int op, int l, int m) {
+    if (p->code_index >= p->code_capacity) {
+        int new_capacity = p->code_capacity ? p->code_capacity * 2 : 1024;
+        p->code = arena_grow(&p->mem, p->code, (size_t)p->code_capacity * sizeof(instruction),
+                             (size_t)new_capacity * sizeof(instruction));
+        if (!p->code) {
+            fprintf(stderr, "Error: out of memory for code.\n");
+            exit(EXIT_FAILURE);
+        }
+        p->code_capacity = new_capacity;
     }
     // Add instruction to code array
-    code[code_index].op = op;
-    code[code_index].l = l;
-    code[code_index].m = m;
-    code_index++; // increment code index
+    p->code[p->code_index].op = op;
+    p->code[p->code_index].l = l;
+    p->code[p->code_index].m = m;
+    p->code_index++; // increment code index
 }
 
 
 // function to print assembly code
-void print_assembly_code() {
+void print_assembly_code(const parser_ctx *p, FILE *out) {
     // mnemonic def for opcodes
-    char *opname[] = {"", "LIT", "OPR", "LOD", "STO", "CAL", "INC", "JMP", "JPC", "SYS"};
-    
+    char *opname[] = {"", "LIT", "OPR", "LOD", "STO", "CAL", "INC", "JMP", "JPC", "SYS", "LLOS", "LLOJ", "LSTO"};
+    outbuf o;
+    out_begin(&o, out);
+
     // Print column header
-    printf("Line OP L M\n");
-    // loop through code array and print instructions
-    for (int i = 0; i < code_index; i++) {
-        printf("%3d %s %d %d\n", i, opname[code[i].op], code[i].l, code[i].m);
+    out_str(&o, "Line OP L M\n");
+    // loop through code array and print instructions ("%3d %s %d %d\n")
+    for (int i = 0; i < p->code_index; i++) {
+        out_int_pad(&o, i, 3, ' ');
+        out_char(&o, ' ');
+        out_str(&o, opname[p->code[i].op]);
+        out_char(&o, ' ');
+        out_int(&o, p->code[i].l);
+        out_char(&o, ' ');
+        out_int(&o, p->code[i].m);
+        out_char(&o, '\n');
     }
+    out_end(&o);
 }
 
 
 // function to print symbol table
-void print_symbol_table() {
-    // symbol table header
-    printf("\nSymbol Table:\n");
-    printf("Kind | Name        | Value | Level | Address\n");
-    printf("-----|-------------|-------|-------|--------\n");
+void print_symbol_table(const parser_ctx *p, const lexContext *lc, FILE *out) {
+    outbuf o;
+    out_begin(&o, out);
 
-    //loop through symbol table and print entries
-    for (int i = 0; i < sym_index; i++) {
-        printf("%4d | %-11s | %5d | %5d | %7d\n", // formatting/alignment
-               sym_table[i].kind, sym_table[i].name, sym_table[i].val, 
-               sym_table[i].level, sym_table[i].addr);
+    // symbol table header
+    out_str(&o, "\nSymbol Table:\n");
+    out_str(&o, "Kind | Name        | Value | Level | Address\n");
+    out_str(&o, "-----|-------------|-------|-------|--------\n");
+
+    //loop through symbol table and print entries ("%4d | %-11s | %5d | %5d | %7d\n")
+    for (int i = 0; i < p->sym_index; i++) {
+        const symbol *sym = &p->sym_table[i];
+        out_int_pad(&o, sym->kind, 4, ' ');
+        out_str(&o, " | ");
+        out_str_left(&o, identName(lc, sym->ident), 11);
+        out_str(&o, " | ");
+        out_int_pad(&o, sym->val, 5, ' ');
+        out_str(&o, " | ");
+        out_int_pad(&o, sym->level, 5, ' ');
+        out_str(&o, " | ");
+        out_int_pad(&o, sym->addr, 7, ' ');
+        out_char(&o, '\n');
     }
-    printf("\n");
+    out_char(&o, '\n');
+    out_end(&o);
 }
 
 
 // function to mark all symbols as used (set mark to 1)
-void mark_all_symbols() {
-    for (int i = 0; i < sym_index; i++) {
-        sym_table[i].mark = 1;
+void mark_all_symbols(parser_ctx *p) {
+    for (int i = 0; i < p->sym_index; i++) {
+        p->sym_table[i].mark = 1;
     }
 }
 
 
 // writes to elf.txt
-void write_code_to_file() {
-    // loop through code array and write instructions elf.txt
-    for (int i = 0; i < code_index; i++) {
-        fprintf(code_file, "%d %d %d\n", code[i].op, code[i].l, code[i].m);
+void write_code_to_file(const parser_ctx *p, FILE *out) {
+    outbuf o;
+    out_begin(&o, out);
+    // loop through code array and write instructions elf.txt ("%d %d %d\n")
+    for (int i = 0; i < p->code_index; i++) {
+        out_int(&o, p->code[i].op);
+        out_char(&o, ' ');
+        out_int(&o, p->code[i].l);
+        out_char(&o, ' ');
+        out_int(&o, p->code[i].m);
+        out_char(&o, '\n');
     }
+    out_end(&o);
 }
 
 
-// function to find symbol in symbol table
-int find_symbol(const char *name, int kind) {
-    // Note: The level check is simplified since level is always 0 in HW3
-    for (int i = sym_index - 1; i >= 0; i--) {
-        if (strcmp(sym_table[i].name, name) == 0) {
-            return i;
+// One line per error of a compile with recovery, then the count. Tokens
+// lexed from source give their line:column and text; tokens.txt tokens
+// only their number.
+void print_diagnostics(FILE *out, const parser_ctx *p, const lexContext *lc) {
+    for (int i = 0; i < p->diag_count; i++) {
+        const diagnostic *d = &p->diags[i];
+        fprintf(out, "%s", error_message(d->code));
+        if (d->token >= p->token_count) {
+            fprintf(out, " (at end of input)\n");
+            continue;
         }
+        const lexeme *t = &p->token_list[d->token];
+        const char *text = lexText(lc, t);
+        if (text) fprintf(out, " (line %d, column %d: %.*s)\n", t->line, t->col, t->length, text);
+        else if (t->token == identsym) fprintf(out, " (token %d: %s)\n", d->token + 1, identName(lc, t->value));
+        else if (t->token == numbersym) fprintf(out, " (token %d: %d)\n", d->token + 1, t->value);
+        else fprintf(out, " (token %d)\n", d->token + 1);
+    }
+    fprintf(out, "%d error%s\n", p->diag_count, p->diag_count == 1 ? "" : "s");
+}
+
+
+// slot in sym_hash for ident: the one holding it, or the empty slot where it would go
+int sym_hash_slot(parser_ctx *p, int ident) {
+    unsigned slot = ((unsigned)ident * 2654435761u) & (p->sym_hash_size - 1);
+    p->compares++;
+    while (p->sym_hash[slot].ident != -1 && p->sym_hash[slot].ident != ident) {
+        slot = (slot + 1) & (p->sym_hash_size - 1);
+        p->compares++;
     }
-    return -1; // not found
+    return slot;
+}
+
+
+// rebuild sym_hash with `size` slots from the symbols still in scope
+void sym_hash_rebuild(parser_ctx *p, int size) {
+    // the old hash stays in the arena until the next compile
+    p->sym_hash = arena_alloc(&p->mem, (size_t)size * sizeof(sym_slot));
+    if (!p->sym_hash) {
+        fprintf(stderr, "Error: out of memory for symbol table.\n");
+        exit(EXIT_FAILURE);
+    }
+    p->sym_hash_size = size;
+    p->sym_hash_used = 0;
+    for (int i = 0; i < size; i++) {
+        p->sym_hash[i].ident = -1;
+        p->sym_hash[i].sym = -1;
+    }
+    // later declarations overwrite earlier ones, so each slot ends on the innermost
+    for (int i = 0; i < p->sym_index; i++) {
+        if (p->sym_table[i].mark) continue;
+        int slot = sym_hash_slot(p, p->sym_table[i].ident);
+        if (p->sym_hash[slot].ident == -1) p->sym_hash_used++;
+        p->sym_hash[slot].ident = p->sym_table[i].ident;
+        p->sym_hash[slot].sym = i;
+    }
+}
+
+
+// function to find symbol in symbol table
+// returns the innermost visible declaration, or -1. Only the enclosing
+// scopes' symbols are in sym_hash (exit_scope() takes a block's out), so
+// that is the one the current block sees.
+int find_symbol(parser_ctx *p, int ident) {
+    p->lookups++;
+    if (p->sym_hash_size == 0) return -1;
+    return p->sym_hash[sym_hash_slot(p, ident)].sym;
 }
 
 
 // function to add symbol to symbol table
-int add_symbol(int kind, const char *name, int val, int level, int addr) {
+// returns its index, or -1 if the name is already declared in this scope
+int add_symbol(parser_ctx *p, int kind, int ident, int val, int level, int addr) {
 
-    // overflow
-    if (sym_index >= MAX_SYMBOL_TABLE_SIZE) {
-        fprintf(stderr, "Error: Symbol table overflow.\n");
-        return -1;
+    // keep the hash at most half full
+    if (p->sym_hash_size == 0 || (p->sym_hash_used + 1) * 2 > p->sym_hash_size) {
+        sym_hash_rebuild(p, p->sym_hash_size ? p->sym_hash_size * 2 : 256);
     }
-    // duplicate check
-    if (find_symbol(name, level) != -1) {
-        error(3);
+    int slot = sym_hash_slot(p, ident);
+    int prev = p->sym_hash[slot].sym;
+
+    // duplicate check (same name in the same scope; outer ones are shadowed)
+    if (prev != -1 && p->sym_table[prev].level == level) {
         return -1;
     }
 
+    // grow
+    if (p->sym_index >= p->sym_capacity) {
+        int new_capacity = p->sym_capacity ? p->sym_capacity * 2 : 256;
+        symbol *grown = arena_grow(&p->mem, p->sym_table, (size_t)p->sym_capacity * sizeof(symbol),
+                                   (size_t)new_capacity * sizeof(symbol));
+        if (!grown) {
+            fprintf(stderr, "Error: Symbol table overflow.\n");
+            exit(EXIT_FAILURE);
+        }
+        p->sym_table = grown;
+        p->sym_capacity = new_capacity;
+    }
+
     // add symbol to table
-    sym_table[sym_index].kind = kind;
-    strncpy(sym_table[sym_index].name, name, MAX_IDENT_LEN);
-    sym_table[sym_index].name[MAX_IDENT_LEN - 1] = '\0';
-    sym_table[sym_index].val = val;
-    sym_table[sym_index].level = level;
-    sym_table[sym_index].addr = addr;
+    p->sym_table[p->sym_index].kind = kind;
+    p->sym_table[p->sym_index].ident = ident;
+    p->sym_table[p->sym_index].val = val;
+    p->sym_table[p->sym_index].level = level;
+    p->sym_table[p->sym_index].addr = addr;
+    p->sym_table[p->sym_index].mark = 0;
+    p->sym_table[p->sym_index].shadow = prev;
+
+    if (p->sym_hash[slot].ident == -1) p->sym_hash_used++;
+    p->sym_hash[slot].ident = ident;
+    p->sym_hash[slot].sym = p->sym_index;
+
+    return p->sym_index++; // increment symbol index upon return
+}
+
+
+// start a new scope; returns the handle to pass to exit_scope()
+int enter_scope(parser_ctx *p) {
+    return p->sym_index;
+}
 
-    return sym_index++; // increment symbol index upon return
+
+// leave the scope started at `first`: mark its symbols and make whatever
+// they shadowed visible again
+void exit_scope(parser_ctx *p, int first) {
+    for (int i = p->sym_index - 1; i >= first; i--) {
+        if (p->sym_table[i].mark) continue;
+        p->sym_table[i].mark = 1;
+        p->sym_hash[sym_hash_slot(p, p->sym_table[i].ident)].sym = p->sym_table[i].shadow;
+    }
 }
 
 
 // GRAMMAR DEFINITIONS AND PARSING FUNCTIONS
 
 
-void program() {
-    emit(JMP, 0, 3); // Jump to address 3 per HW3 spec requirement
+void program(parser_ctx *p) {
+    emit(p, JMP, 0, 3); // Jump to address 3 per HW3 spec requirement
     
     int data_size; // initialize data size
-    block(0, &data_size); // parse main block at level 0
+    block(p, 0, &data_size); // parse main block at level 0
 
     // ensure program ends with period
-    if (current_token != periodsym) {
-        error(16);
+    if (p->current_token != periodsym) {
+        error(p, 16);
     }
     
-    emit(SYS, 0, 3); // halt instruction
+    emit(p, SYS, 0, 3); // halt instruction
 }
 
 
-void block(int level, int *data_size) {
+void block(parser_ctx *p, int level, int *data_size) {
+    int scope = block_head(p, level, data_size);
+    statement(p, level);
+    exit_scope(p, scope);
+}
+
+
+// declarations and INC of a block; returns its scope handle
+int block_head(parser_ctx *p, int level, int *data_size) {
+    int scope = enter_scope(p);
     *data_size = 3; // reserve space for static link, dynamic link, return address
-    const_declaration(level);
-    var_declaration(level, data_size);
+    declarations(p, level, data_size);
+
+    emit(p, INC, 0, *data_size); // allocate space for variables
+    return scope;
+}
 
-    emit(INC, 0, *data_size); // allocate space for variables
 
-    statement(level);
+// const_declaration(), var_declaration() and proc_declaration();
+// recovering, an error in any of them skips the rest of that section's
+// declaration
+void declarations(parser_ctx *p, int level, int *data_size) {
+    if (!p->recover) {
+        const_declaration(p, level);
+        var_declaration(p, level, data_size);
+        proc_declaration(p, level);
+        return;
+    }
+    jmp_buf outer;
+    memcpy(outer, p->on_error, sizeof(jmp_buf));
+    for (int section = 0; section < 3; section++) {
+        if (setjmp(p->on_error) == 0) {
+            if (section == 0) const_declaration(p, level);
+            else if (section == 1) var_declaration(p, level, data_size);
+            else proc_declaration(p, level);
+        } else {
+            skip_declaration(p);
+            // a section that starts after the error is parsed from its keyword
+            if (p->current_token == constsym) section = -1;
+            else if (p->current_token == varsym) section = 0;
+            else if (p->current_token == procsym) section = 1;
+        }
+    }
+    memcpy(p->on_error, outer, sizeof(jmp_buf));
 }
 
 
-void const_declaration(int level) {
-    if (current_token == constsym) {
-        advance_token();
+// skip past the ; that ends a declaration, or up to what follows the declarations
+void skip_declaration(parser_ctx *p) {
+    for (;;) {
+        int t = p->current_token;
+        if (t == semicolonsym) {
+            advance_token(p);
+            return;
+        }
+        if (t == skipsym || t == periodsym || t == constsym || t == varsym || t == procsym ||
+            t == beginsym || t == ifsym || t == whilesym || t == callsym || t == readsym || t == writesym) return;
+        advance_token(p);
+    }
+}
+
+
+void const_declaration(parser_ctx *p, int level) {
+    if (p->current_token == constsym) {
+        advance_token(p);
         
         // process constant declarations
         do {
-            if (current_token != identsym) {
-                error(2);
+            if (p->current_token != identsym) {
+                error(p, 2);
             }
-            char ident_name[MAX_IDENT_LEN];
-            strcpy(ident_name, current_lexeme);
-            advance_token();
+            int ident = p->current_ident;
+            advance_token(p);
 
-            if (current_token != eqlsym) {
-                error(4);
+            if (p->current_token != eqlsym) {
+                error(p, 4);
             }
-            advance_token();
+            advance_token(p);
 
-            if (current_token != numbersym) {
-                error(5);
+            if (p->current_token != numbersym) {
+                error(p, 5);
             }
-            int val = current_number_val;
+            int val = p->current_number_val;
             
-            add_symbol(CONSTANT, ident_name, val, level, 0);
+            if (add_symbol(p, CONSTANT, ident, val, level, 0) < 0) {
+                error(p, 3);
+            }
             
-            advance_token();
+            advance_token(p);
             
-        } while (current_token == commasym && (advance_token(), 1));
+        } while (p->current_token == commasym && (advance_token(p), 1));
 
-        if (current_token != semicolonsym) {
-            error(6);
+        if (p->current_token != semicolonsym) {
+            error(p, 6);
         }
-        advance_token();
+        advance_token(p);
     }
 }
 
-void var_declaration(int level, int *data_size) {
+void var_declaration(parser_ctx *p, int level, int *data_size) {
     // Handle variable declarations
-    if (current_token == varsym) {
-        advance_token();
+    if (p->current_token == varsym) {
+        advance_token(p);
         
         do {
-            if (current_token != identsym) {
-                error(2);
+            if (p->current_token != identsym) {
+                error(p, 2);
             }
             
-            add_symbol(VARIABLE, current_lexeme, 0, level, *data_size);
+            if (add_symbol(p, VARIABLE, p->current_ident, 0, level, *data_size) < 0) {
+                error(p, 3);
+            }
             (*data_size)++;
             
-            advance_token();
+            advance_token(p);
             
-        } while (current_token == commasym && (advance_token(), 1));
+        } while (p->current_token == commasym && (advance_token(p), 1));
+
+        if (p->current_token != semicolonsym) {
+            error(p, 6);
+        }
+        advance_token(p);
+    }
+}
+
+
+// procedure declarations: each body is a block at level + 1 ended by RTN.
+// Their code comes before the declaring block's INC, so a procedure with
+// nested procedures starts with a JMP over them (main's is the JMP at
+// code[0]); one without starts at its INC.
+void proc_declaration(parser_ctx *p, int level) {
+    if (p->current_token != procsym) return;
+
+    int jmp = 0;
+    if (level > 0) {
+        jmp = p->code_index;
+        emit(p, JMP, 0, 0);
+    }
+    // recovering, a bad header is reported and the body parsed anyway
+    while (p->current_token == procsym) {
+        advance_token(p);
+        if (p->current_token == identsym) {
+            // the body's code starts here; declared first so it can recurse
+            if (add_symbol(p, PROCEDURE, p->current_ident, 0, level, CODE_ADDR(p->code_index)) < 0) {
+                soft_error(p, 3);
+            }
+            advance_token(p);
+        } else {
+            soft_error(p, 17);
+            while (p->current_token != semicolonsym && p->current_token != skipsym && p->current_token != periodsym &&
+                   p->current_token != constsym && p->current_token != varsym && p->current_token != beginsym) {
+                advance_token(p);
+            }
+        }
+        if (p->current_token != semicolonsym) {
+            soft_error(p, 18);
+        } else {
+            advance_token(p);
+        }
+
+        int data_size;
+        block(p, level + 1, &data_size);
+        emit(p, OPR, 0, 0); // RTN
 
-        if (current_token != semicolonsym) {
-            error(6);
+        if (p->current_token != semicolonsym) {
+            soft_error(p, 18);
+        } else {
+            advance_token(p);
         }
-        advance_token();
     }
+    p->code[jmp].m = CODE_ADDR(p->code_index); // the INC
 }
 
 
-void statement(int level) {
+// A statement; recovering, an error inside it is recorded and the rest of
+// it skipped, so parsing goes on after it
+void statement(parser_ctx *p, int level) {
+    if (!p->recover) {
+        parse_statement(p, level);
+        return;
+    }
+    jmp_buf outer;
+    int start = p->token_ptr - 1;
+    memcpy(outer, p->on_error, sizeof(jmp_buf));
+    if (setjmp(p->on_error) == 0) parse_statement(p, level);
+    else skip_statement(p, start);
+    memcpy(p->on_error, outer, sizeof(jmp_buf));
+}
+
+
+// skip the rest of the statement that started at tokens[start]: up to the
+// ; end fi or . after it, past the end or fi of each begin or if it opened
+void skip_statement(parser_ctx *p, int start) {
+    int begins = 0, ifs = 0; // still open
+    for (int i = start; i < p->token_ptr - 1; i++) {
+        int t = p->token_list[i].token;
+        if (t == beginsym) begins++;
+        else if (t == ifsym) ifs++;
+        else if (t == endsym && begins > 0) begins--;
+        else if (t == fisym && ifs > 0) ifs--;
+    }
+    for (;;) {
+        int t = p->current_token;
+        if (t == skipsym || t == periodsym) return;
+        if (t == semicolonsym && begins == 0 && ifs == 0) return;
+        if (t == beginsym) {
+            begins++;
+        } else if (t == ifsym) {
+            ifs++;
+        } else if (t == endsym || t == fisym) {
+            int *open = t == endsym ? &begins : &ifs;
+            if (*open == 0) return; // closes an enclosing statement
+            advance_token(p);
+            if (--*open == 0 && begins == 0 && ifs == 0) return;
+            continue;
+        }
+        advance_token(p);
+    }
+}
+
+
+void parse_statement(parser_ctx *p, int level) {
     int sym_idx;
     int cx1, cx2;
     // Handle different statement types
-    if (current_token == identsym) {
-        char ident_name[MAX_IDENT_LEN];
-        strcpy(ident_name, current_lexeme);
-        sym_idx = find_symbol(ident_name, level);
+    if (p->current_token == identsym) {
+        sym_idx = find_symbol(p, p->current_ident);
 
         if (sym_idx == -1) {
-            error(7);
+            error(p, 7);
         }
-        if (sym_table[sym_idx].kind != VARIABLE) {
-            error(8);
+        if (p->sym_table[sym_idx].kind != VARIABLE) {
+            error(p, 8);
         }
 
-        advance_token();
+        advance_token(p);
         
-        if (current_token != becomessym) {
-            error(9);
+        if (p->current_token != becomessym) {
+            error(p, 9);
         }
-        advance_token();
+        advance_token(p);
 
-        expression(level);
+        expression(p, level);
         
-        emit(STO, level - sym_table[sym_idx].level, sym_table[sym_idx].addr);
-    } else if (current_token == readsym) {// read statement
-        advance_token();
-        if (current_token != identsym) {
-            error(2);
+        emit(p, STO, level - p->sym_table[sym_idx].level, p->sym_table[sym_idx].addr);
+    } else if (p->current_token == callsym) {// call statement
+        advance_token(p);
+        if (p->current_token != identsym) {
+            error(p, 17);
+        }
+
+        sym_idx = find_symbol(p, p->current_ident);
+        if (sym_idx == -1) {
+            error(p, 7);
+        }
+        if (p->sym_table[sym_idx].kind != PROCEDURE) {
+            error(p, 19);
+        }
+
+        emit(p, CAL, level - p->sym_table[sym_idx].level, p->sym_table[sym_idx].addr);
+        advance_token(p);
+
+    } else if (p->current_token == readsym) {// read statement
+        advance_token(p);
+        if (p->current_token != identsym) {
+            error(p, 2);
         }
         
-        sym_idx = find_symbol(current_lexeme, level);
+        sym_idx = find_symbol(p, p->current_ident);
         if (sym_idx == -1) {
-            error(7);
+            error(p, 7);
         }
-        if (sym_table[sym_idx].kind != VARIABLE) {
-            error(8);
+        if (p->sym_table[sym_idx].kind != VARIABLE) {
+            error(p, 8);
         }
         
-        emit(SYS, 0, 2);
-        emit(STO, level - sym_table[sym_idx].level, sym_table[sym_idx].addr);
-        advance_token();
-
-    } else if (current_token == writesym) {// write statement
-        advance_token();
-        expression(level);
-        emit(SYS, 0, 1);
-
-    } else if (current_token == beginsym) {// begin...end block
-        advance_token();
-        statement(level);
+        emit(p, SYS, 0, 2);
+        emit(p, STO, level - p->sym_table[sym_idx].level, p->sym_table[sym_idx].addr);
+        advance_token(p);
+
+    } else if (p->current_token == writesym) {// write statement
+        advance_token(p);
+        expression(p, level);
+        emit(p, SYS, 0, 1);
+
+    } else if (p->current_token == beginsym) {// begin...end block
+        advance_token(p);
+        statement(p, level);
         
-        while (current_token == semicolonsym) {
-            advance_token();
-            statement(level);
+        for (;;) {
+            while (p->current_token == semicolonsym) {
+                advance_token(p);
+                statement(p, level);
+            }
+            // recovering, a stray token after a statement is reported and
+            // skipped up to the next ; or end of this block, which goes on
+            int t = p->current_token;
+            if (!p->recover || t == endsym || t == fisym || t == periodsym || t == skipsym) break;
+            report_error(p, 10);
+            skip_statement(p, p->token_ptr - 1);
         }
 
-        if (current_token != endsym) {
-            error(10);
+        if (p->current_token != endsym) {
+            missing_closer(p, 10);
+        } else {
+            advance_token(p);
         }
-        advance_token();
 
-    } else if (current_token == ifsym) {// if...then...fi statement
-        advance_token();
-        condition(level);
+    } else if (p->current_token == ifsym) {// if...then...fi statement
+        advance_token(p);
+        condition(p, level);
 
-        if (current_token != thensym) {
-            error(11);
+        if (p->current_token != thensym) {
+            error(p, 11);
         }
-        advance_token();
+        advance_token(p);
 
-        cx1 = code_index;
-        emit(JPC, 0, 0); 
+        cx1 = p->code_index;
+        emit(p, JPC, 0, 0); 
         
-        statement(level);
+        statement(p, level);
         
-        code[cx1].m = code_index;
+        p->code[cx1].m = CODE_ADDR(p->code_index);
 
-        if (current_token != fisym) {
-            error(32);
+        if (p->current_token != fisym) {
+            missing_closer(p, 32);
+        } else {
+            advance_token(p);
         }
-        advance_token();
 
-    } else if (current_token == whilesym) {// while...do statement
-        advance_token();
+    } else if (p->current_token == whilesym) {// while...do statement
+        advance_token(p);
         
-        cx1 = code_index;
-        condition(level);
+        cx1 = p->code_index;
+        condition(p, level);
         
-        if (current_token != dosym) {
-            error(12);
+        if (p->current_token != dosym) {
+            error(p, 12);
         }
-        advance_token();
+        advance_token(p);
         
-        cx2 = code_index;
-        emit(JPC, 0, 0); 
+        cx2 = p->code_index;
+        emit(p, JPC, 0, 0); 
         
-        statement(level);
+        statement(p, level);
         
-        emit(JMP, 0, cx1);
+        emit(p, JMP, 0, CODE_ADDR(cx1));
         
-        code[cx2].m = code_index;
+        p->code[cx2].m = CODE_ADDR(p->code_index);
     }
 }
 
 
-void condition(int level) {
-    if (current_token == evensym) {
-        advance_token();
-        expression(level);
-        emit(OPR, 0, 11);  // EVEN per ISA Table 2
+void condition(parser_ctx *p, int level) {
+    if (p->current_token == evensym) {
+        advance_token(p);
+        expression(p, level);
+        emit(p, OPR, 0, 11);  // EVEN per ISA Table 2
     } else {
-        expression(level); // left-hand side
+        expression(p, level); // left-hand side
         
-        int rel_op = current_token;
+        int rel_op = p->current_token;
         if (rel_op < eqlsym || rel_op > geqsym) {
-            error(13);
+            error(p, 13);
         }
-        advance_token(); // consume relational operator
+        advance_token(p); // consume relational operator
 
-        expression(level); // right-hand side
+        expression(p, level); // right-hand side
 
         // Emit appropriate OPR instruction based on relational operator
         // Per ISA Table 2: EQL=5, NEQ=6, LSS=7, LEQ=8, GTR=9, GEQ=10
         switch (rel_op) {
-            case eqlsym:  emit(OPR, 0, 5); break;  // EQL
-            case neqsym:  emit(OPR, 0, 6); break;  // NEQ
-            case lessym:  emit(OPR, 0, 7); break;  // LSS
-            case leqsym:  emit(OPR, 0, 8); break;  // LEQ
-            case gtrsym:  emit(OPR, 0, 9); break;  // GTR
-            case geqsym:  emit(OPR, 0, 10); break; // GEQ
+            case eqlsym:  emit(p, OPR, 0, 5); break;  // EQL
+            case neqsym:  emit(p, OPR, 0, 6); break;  // NEQ
+            case lessym:  emit(p, OPR, 0, 7); break;  // LSS
+            case leqsym:  emit(p, OPR, 0, 8); break;  // LEQ
+            case gtrsym:  emit(p, OPR, 0, 9); break;  // GTR
+            case geqsym:  emit(p, OPR, 0, 10); break; // GEQ
         }
     }
 }
 
 
-void expression(int level) {
+void expression(parser_ctx *p, int level) {
     int op;
-    term(level);
+    term(p, level);
     // Handle addition and subtraction
-    while (current_token == plussym || current_token == minussym) {
-        op = current_token;
-        advance_token();
-        term(level);
+    while (p->current_token == plussym || p->current_token == minussym) {
+        op = p->current_token;
+        advance_token(p);
+        term(p, level);
         if (op == plussym) {
-            emit(OPR, 0, 1);  // ADD per ISA Table 2
+            emit(p, OPR, 0, 1);  // ADD per ISA Table 2
         } else {
-            emit(OPR, 0, 2);  // SUB per ISA Table 2
+            emit(p, OPR, 0, 2);  // SUB per ISA Table 2
         }
     }
 }
 
 
-void term(int level) {
+void term(parser_ctx *p, int level) {
     int op;
-    factor(level);
+    factor(p, level);
     // Handle multiplication and division
-    while (current_token == multsym || current_token == slashsym) {
-        op = current_token;
-        advance_token();
-        factor(level);
+    while (p->current_token == multsym || p->current_token == slashsym) {
+        op = p->current_token;
+        advance_token(p);
+        factor(p, level);
         if (op == multsym) {
-            emit(OPR, 0, 3);  // MUL per ISA Table 2
+            emit(p, OPR, 0, 3);  // MUL per ISA Table 2
         } else {
-            emit(OPR, 0, 4);  // DIV per ISA Table 2
+            emit(p, OPR, 0, 4);  // DIV per ISA Table 2
         }
     }
 }
 
 
-void factor(int level) {
+void factor(parser_ctx *p, int level) {
     int sym_idx;
     // Handle identifier, number, or parenthesized expression
-    if (current_token == identsym) {
-        sym_idx = find_symbol(current_lexeme, level);
+    if (p->current_token == identsym) {
+        sym_idx = find_symbol(p, p->current_ident);
         if (sym_idx == -1) {
-            error(7);
+            error(p, 7);
         }
         // Load constant or variable value
-        if (sym_table[sym_idx].kind == CONSTANT) {
-            emit(LIT, 0, sym_table[sym_idx].val);
-        } else if (sym_table[sym_idx].kind == VARIABLE) {
-            emit(LOD, level - sym_table[sym_idx].level, sym_table[sym_idx].addr);
-            // advance_token();
-        }
-
-        advance_token();
-    } else if (current_token == numbersym) {
-        emit(LIT, 0, current_number_val);
-        advance_token();
-    } else if (current_token == lparentsym) {
-        advance_token();
-        expression(level);
-        if (current_token != rparentsym) {
-            error(14);
-        }
-        advance_token();
+        if (p->sym_table[sym_idx].kind == CONSTANT) {
+            emit(p, LIT, 0, p->sym_table[sym_idx].val);
+        } else if (p->sym_table[sym_idx].kind == VARIABLE) {
+            emit(p, LOD, level - p->sym_table[sym_idx].level, p->sym_table[sym_idx].addr);
+            // advance_token(p);
+        } else {
+            error(p, 20);
+        }
+
+        advance_token(p);
+    } else if (p->current_token == numbersym) {
+        emit(p, LIT, 0, p->current_number_val);
+        advance_token(p);
+    } else if (p->current_token == lparentsym) {
+        advance_token(p);
+        expression(p, level);
+        if (p->current_token != rparentsym) {
+            error(p, 14);
+        }
+        advance_token(p);
     } else {
-        error(15);
+        error(p, 15);
+    }
+}
+
+
+void parser_init(parser_ctx *p) {
+    memset(p, 0, sizeof(*p));
+    arena_init(&p->mem);
+}
+
+
+void parser_free(parser_ctx *p) {
+    arena_free(&p->mem);
+    parser_init(p);
+}
+
+
+// start a fresh compile of tokens[0..count)
+void parse_reset(parser_ctx *p, const lexeme *tokens, int count) {
+    // everything from the previous compile goes in one arena reset
+    arena_reset(&p->mem);
+    p->code = NULL;
+    p->code_index = p->code_capacity = 0;
+    p->sym_table = NULL;
+    p->sym_index = p->sym_capacity = 0;
+    p->sym_hash = NULL;
+    p->sym_hash_size = p->sym_hash_used = 0;
+    p->lookups = p->compares = 0;
+
+    p->token_list = tokens;
+    p->token_count = count;
+    p->token_ptr = 0;
+    p->error_flag = 0;
+    p->error_msg = NULL;
+    p->diags = NULL;
+    p->diag_count = p->diag_capacity = 0;
+    p->last_error_token = -1;
+}
+
+
+// Parse a whole token stream into p->code (resets the previous compile)
+int parse_program(parser_ctx *p, const lexeme *tokens, int count) {
+    parse_reset(p, tokens, count);
+
+    if (setjmp(p->on_error)) {
+        if (p->recover) p->code_index = 0; // the code of a failed compile isn't kept
+        return -1; // error() gave up on this compile
+    }
+
+    advance_token(p); // Initialize first token
+    
+    if (p->current_token == skipsym) {
+        error(p, 1); 
+    }
+
+    program(p); // Start parsing
+    if (p->error_flag) {
+        p->code_index = 0; // errors were recovered from
+        return -1;
+    }
+    return 0;
+}
+
+
+// The main block's body, one top-level statement at a time (incremental.c).
+// Each step parses exactly what program() would at that point, so the
+// code and the first error are the same as a parse_program() compile.
+int parse_body_start(parser_ctx *p, const lexeme *tokens, int count) {
+    parse_reset(p, tokens, count);
+
+    if (setjmp(p->on_error)) {
+        return -1;
+    }
+
+    advance_token(p);
+    if (p->current_token == skipsym) {
+        error(p, 1);
+    }
+
+    emit(p, JMP, 0, 3);
+    int data_size;
+    int scope = block_head(p, 0, &data_size);
+    if (p->current_token != beginsym) {
+        // a single-statement body: nothing to split up
+        statement(p, 0);
+        exit_scope(p, scope);
+        if (p->current_token != periodsym) {
+            error(p, 16);
+        }
+        emit(p, SYS, 0, 3);
+        return 0;
+    }
+    advance_token(p);
+    return 1;
+}
+
+
+int parse_body_resume(parser_ctx *p, const lexeme *tokens, int count, int token, int code_index) {
+    p->token_list = tokens;
+    p->token_count = count;
+    p->token_ptr = token;
+    p->code_index = code_index;
+    p->error_flag = 0;
+    p->error_msg = NULL;
+
+    // the main block's symbols are visible again (exit_scope hid them)
+    for (int i = 0; i < p->sym_index; i++) {
+        if (p->sym_table[i].level != 0 || !p->sym_table[i].mark) continue;
+        p->sym_table[i].mark = 0;
+        p->sym_hash[sym_hash_slot(p, p->sym_table[i].ident)].sym = i;
+    }
+
+    if (setjmp(p->on_error)) {
+        return -1;
+    }
+    advance_token(p);
+    return 0;
+}
+
+
+int parse_body_statement(parser_ctx *p) {
+    if (setjmp(p->on_error)) {
+        return -1;
+    }
+
+    statement(p, 0);
+    if (p->current_token == semicolonsym) {
+        advance_token(p);
+        return 1;
+    }
+
+    // the rest of statement(beginsym), block() and program()
+    if (p->current_token != endsym) {
+        error(p, 10);
+    }
+    advance_token(p);
+    exit_scope(p, 0);
+    if (p->current_token != periodsym) {
+        error(p, 16);
     }
+    emit(p, SYS, 0, 3);
+    return 0;
+}
+
+
+#ifndef PARSER_LIBRARY
+// --stats: wall time of each phase of one compile (monotonic clock)
+#define MAX_PHASES 10
+
+typedef struct {
+    const char *name[MAX_PHASES];
+    double seconds[MAX_PHASES];
+    int count;
+    double mark;              // end of the previous phase
+} phase_timer;
+
+
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+// record the phase that ran since the last end_phase() (or the start)
+void end_phase(phase_timer *t, const char *name) {
+    double now = now_seconds();
+    if (t->count < MAX_PHASES) {
+        t->name[t->count] = name;
+        t->seconds[t->count++] = now - t->mark;
+    }
+    t->mark = now;
+}
+
+
+// whole source file in a null-terminated buffer, NULL if it can't be read
+char *read_source(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        perror("File open error");
+        return NULL;
+    }
+    size_t len = 0, cap = 65536, n;
+    char *text = malloc(cap);
+    while (text && (n = fread(text + len, 1, cap - len - 1, fp)) > 0) {
+        len += n;
+        if (cap - len - 1 == 0) {
+            char *grown = realloc(text, cap * 2);
+            if (!grown) free(text);
+            text = grown;
+            cap *= 2;
+        }
+    }
+    fclose(fp);
+    if (!text) {
+        fprintf(stderr, "Error: out of memory reading '%s'.\n", path);
+        return NULL;
+    }
+    text[len] = '\0';
+    return text;
+}
+
+
+void print_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fprintf(out, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) fprintf(out, "\\u%04x", *s);
+        else fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+
+// the --stats report: a summary, or one JSON object per compile for CI
+void print_stats(FILE *out, int json, const char *source, const phase_timer *t, const lexContext *lc,
+                 const parser_ctx *p, int emitted, long bytes) {
+    double total = 0;
+    for (int i = 0; i < t->count; i++) total += t->seconds[i];
+
+    if (json) {
+        fprintf(out, "{\"source\": ");
+        print_json_string(out, source);
+        fprintf(out, ", \"ok\": %s, ", p->error_flag ? "false" : "true");
+        if (p->error_msg) {
+            fprintf(out, "\"error\": ");
+            print_json_string(out, p->error_msg);
+            fprintf(out, ", ");
+        }
+        fprintf(out, "\"phases_ms\": {");
+        for (int i = 0; i < t->count; i++) {
+            fprintf(out, "%s\"%s\": %.6f", i ? ", " : "", t->name[i], t->seconds[i] * 1e3);
+        }
+        fprintf(out, "}, \"total_ms\": %.6f, \"tokens\": %d, \"identifiers\": %d, \"symbols\": %d, "
+                "\"lookups\": %lld, \"compares\": %lld, \"instructions_emitted\": %d, \"instructions\": %d, "
+                "\"bytes_written\": %ld}\n",
+                total * 1e3, lc->tableIndex, lc->identCount, p->sym_index,
+                p->lookups, p->compares, emitted, p->code_index, bytes);
+        return;
+    }
+
+    fprintf(out, "Compile statistics for %s:\n", source);
+    for (int i = 0; i < t->count; i++) {
+        fprintf(out, "  %-20s %10.3f ms %5.1f%%\n", t->name[i], t->seconds[i] * 1e3,
+                total > 0 ? 100 * t->seconds[i] / total : 0);
+    }
+    fprintf(out, "  %-20s %10.3f ms\n", "total", total * 1e3);
+    fprintf(out, "  tokens %d, identifiers %d, symbols %d\n", lc->tableIndex, lc->identCount, p->sym_index);
+    fprintf(out, "  find_symbol lookups %lld, sym_hash compares %lld (%.2f per lookup)\n",
+            p->lookups, p->compares, p->lookups ? (double)p->compares / p->lookups : 0);
+    fprintf(out, "  instructions emitted %d, written %d; bytes written %ld\n", emitted, p->code_index, bytes);
 }
 
 
 // --- MAIN FUNCTION ---
-int main(void) {
-    code_file = fopen(CODE_FILENAME, "w"); // Open output file
+int main(int argc, char *argv[]) {
+    FILE *code_file = fopen(CODE_FILENAME, "w"); // Open output file
     if (!code_file) { // Check for file open error
         fprintf(stderr, "Error: Could not open output file '%s'.\n", CODE_FILENAME);
         return EXIT_FAILURE;
     }
 
-    read_token_list(); // Load tokens from file
-    // printf("Tokens loaded:\n");
-    // // Print loaded tokens for debugging
-    // for (int i = 0; i < token_count; i++) {
-    //     printf("%2d: token=%2d lexeme='%s'\n", i, token_list[i], token_lexeme[i]);
-    // }
-    // Check if any tokens were read
-    if (token_count == 0) {
-        fprintf(stderr, "Error: Token input file '%s' is empty or invalid.\n", TOKEN_FILENAME);
-        fprintf(code_file, "Error: Token input file '%s' is empty or invalid.\n", TOKEN_FILENAME);
-        fclose(code_file);
-        return EXIT_SUCCESS;
+    const char *source_path = NULL, *object_path = NULL;
+    int dump_tokens = 0, optimize = 0, fuse = 0, use_ir = 0, dump_ir = 0, stats = 0, stats_json = 0;
+    int all_errors = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dump-tokens") == 0) dump_tokens = 1;
+        else if (strcmp(argv[i], "--optimize") == 0) optimize = 1;
+        else if (strcmp(argv[i], "--fuse") == 0) fuse = 1;
+        else if (strcmp(argv[i], "--all-errors") == 0) all_errors = 1;
+        else if (strcmp(argv[i], "--ir") == 0) use_ir = 1;
+        else if (strcmp(argv[i], "--dump-ir") == 0) use_ir = dump_ir = 1;
+        else if (strcmp(argv[i], "--stats") == 0) stats = 1;
+        else if (strcmp(argv[i], "--stats=json") == 0) stats = stats_json = 1;
+        else if (strcmp(argv[i], "--object") == 0 && i + 1 < argc) object_path = argv[++i];
+        else if (!source_path) source_path = argv[i];
     }
 
-    advance_token(); // Initialize first token
-    
-    if (current_token == skipsym) {
-        error(1); 
+    // one compilation: lexer state (tokens, identifier names) and parser state
+    parser_ctx ctx;
+    lexContext lc;
+    lexInit(&lc);
+    parser_init(&ctx);
+
+    phase_timer timer;
+    timer.count = 0;
+    timer.mark = now_seconds();
+
+    const lexeme *tokens;
+    int token_count;
+    char *text = NULL; // --stats reads the source itself; the tokens point into it
+    if (source_path) {
+        // in-process pipeline: lexer() -> token table -> parser
+        if (stats) {
+            // read the whole file first so reading and lexing are timed apart
+            text = read_source(source_path);
+            if (!text) {
+                exit(EXIT_FAILURE);
+            }
+            end_phase(&timer, "read");
+            lexer(&lc, text);
+        } else if (lexFile(&lc, source_path) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        end_phase(&timer, "lexer");
+        if (dump_tokens) {
+            FILE *fp = fopen(TOKEN_FILENAME, "w");
+            if (fp) {
+                printTokenList(fp, &lc);
+                fclose(fp);
+            }
+            end_phase(&timer, "dump_tokens");
+        }
+        tokens = lc.table;
+        token_count = lc.tableIndex;
+    } else {
+        token_count = read_token_list(&lc); // Load tokens from file
+        tokens = lc.table;
+        end_phase(&timer, "read_token_list");
+    }
+    // Check if any tokens were read
+    if (token_count == 0) {
+        const char *what = source_path ? "Source file" : "Token input file";
+        const char *path = source_path ? source_path : TOKEN_FILENAME;
+        fprintf(stderr, "Error: %s '%s' is empty or invalid.\n", what, path);
+        fprintf(code_file, "Error: %s '%s' is empty or invalid.\n", what, path);
+        goto out;
     }
 
-    program(); // Start parsing
-
-    if (!error_flag) {
-        mark_all_symbols(); // Mark all symbols as used before exit
-        print_symbol_table();
-        print_assembly_code();
-        write_code_to_file();
+    ctx.recover = all_errors;
+    int status = parse_program(&ctx, tokens, token_count);
+    int emitted = ctx.code_index;
+    end_phase(&timer, "program");
+    if (status < 0) {
+        if (all_errors && ctx.diag_count > 0) {
+            print_diagnostics(stderr, &ctx, &lc);
+            print_diagnostics(code_file, &ctx, &lc);
+        } else if (ctx.error_msg) {
+            fprintf(stderr, "%s\n", ctx.error_msg);// Print to stderr
+            fprintf(code_file, "%s\n", ctx.error_msg);// Print to elf.txt
+        }
+    } else {
+        if (use_ir) {
+            ir_func ir;
+            ir_stats stats;
+            instruction *lowered = NULL;
+            int lowered_count = -1;
+            ir_init(&ir);
+            if (ir_build(&ir, ctx.code, ctx.code_index) == 0) {
+                ir_optimize(&ir, &stats);
+                if (dump_ir) {
+                    FILE *fp = fopen(IR_FILENAME, "w");
+                    if (fp) {
+                        ir_print(&ir, fp);
+                        fclose(fp);
+                    }
+                }
+                lowered_count = ir_lower(&ir, &lowered);
+            }
+            if (lowered_count >= 0) {
+                printf("IR: %d -> %d instructions (%d cse, %d loads, %d folded, %d stores, %d temps)\n",
+                       ctx.code_index, lowered_count, stats.cse, stats.loads, stats.folded, stats.stores, ir.temps);
+                // back into the parser's code buffer, which --optimize and the listings use
+                ctx.code_index = 0;
+                for (int i = 0; i < lowered_count; i++) emit(&ctx, lowered[i].op, lowered[i].l, lowered[i].m);
+            } else {
+                printf("IR: code left unchanged\n");
+            }
+            free(lowered);
+            ir_free(&ir);
+            end_phase(&timer, "ir");
+        }
+        if (optimize) {
+            opt_stats stats;
+            ctx.code_index = optimize_code(ctx.code, ctx.code_index, &stats);
+            printf("Optimizer: %d -> %d instructions (%d folded, %d identities, %d branches, %d dead)\n",
+                   stats.before, stats.after, stats.folded, stats.identities, stats.branches, stats.dead);
+            end_phase(&timer, "optimize");
+        }
+        if (fuse) {
+            fuse_stats stats;
+            fuse_code(ctx.code, ctx.code_index, &stats);
+            printf("Fused: %d LLOS, %d LLOJ, %d LSTO superinstructions\n", stats.llos, stats.lloj, stats.lsto);
+            end_phase(&timer, "fuse");
+        }
+        mark_all_symbols(&ctx); // Mark all symbols as used before exit
+        print_symbol_table(&ctx, &lc, stdout);
+        print_assembly_code(&ctx, stdout);
+        end_phase(&timer, "listings");
+        write_code_to_file(&ctx, code_file);
+        fflush(code_file);
+        end_phase(&timer, "write_code_to_file");
         printf("Parsing and code generation successful. Output written to %s.\n", CODE_FILENAME);
+        if (object_path) {
+            const char **names = malloc((size_t)ctx.sym_index * sizeof(char *) + 1);
+            for (int i = 0; names && i < ctx.sym_index; i++) names[i] = identName(&lc, ctx.sym_table[i].ident);
+            if (names && obj_write(object_path, ctx.code, ctx.code_index, ctx.sym_table, ctx.sym_index, names) == 0) {
+                printf("Object code written to %s.\n", object_path);
+            }
+            free(names);
+            end_phase(&timer, "object");
+        }
+    }
+    if (stats) {
+        print_stats(stderr, stats_json, source_path ? source_path : TOKEN_FILENAME, &timer, &lc, &ctx,
+                    emitted, ftell(code_file));
     }
 
+out:
+    parser_free(&ctx);
+    lexFree(&lc);
+    free(text);
     fclose(code_file); //Finished wooooo
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+#endif
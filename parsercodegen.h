@@ -0,0 +1,177 @@
+/*
+    parsercodegen.h - Shared interface for the PL/0 parser/code generator
+
+    Lets other programs (benchmarks, tools) drive the parser in-process and
+    read the generated PM/0 code and symbol table.
+
+    To Compile (library mode, no main() in parsercodegen.c):
+        gcc -O2 -std=c11 -DLEX_LIBRARY -DPARSER_LIBRARY -c parsercodegen.c lex.c
+*/
+
+#ifndef PARSERCODEGEN_H
+#define PARSERCODEGEN_H
+
+#include <setjmp.h>
+#include "lex.h"
+
+// PM/0 code addresses count words and each instruction is 3 words
+// (OP, L, M), so JMP/JPC/CAL targets are 3 * instruction index
+#define CODE_ADDR(index) ((index) * 3)
+#define CODE_INDEX(addr) ((addr) / 3)
+
+// OPR sub-operations (ISA Table 2)
+enum opr_code {
+    RTN = 0, ADD, SUB, MUL, DIV, EQL, NEQ, LSS, LEQ, GTR, GEQ, EVEN
+};
+
+// OPR ADD/SUB/MUL wrap around (two's complement) and DIV truncates, with
+// INT_MIN / -1 wrapping to INT_MIN; the VM, the JIT, aot's C and the
+// constant folders all compute this. b must not be 0.
+static inline int opr_div(int a, int b) {
+    return b == -1 ? (int)(0u - (unsigned)a) : a / b;
+}
+
+// SYS sub-operations
+enum sys_code {
+    SYS_WRITE = 1, SYS_READ = 2, SYS_HALT = 3
+};
+
+// Enum Definitions (token_type comes from lex.h)
+enum opcode {
+    LIT = 1, OPR, LOD, STO, CAL, INC, JMP, JPC, SYS
+};
+
+// Superinstructions (parsercodegen --fuse, see fuse_code() in optimizer.c).
+// Only the first instruction of a fused sequence changes: its opcode names
+// the whole sequence and the rest stays in place as its operands, so code
+// addresses and jump targets don't move. Not part of plain PM/0.
+enum fused_opcode {
+    LLOS = SYS + 1, // LOD 0 x; LIT c; OPR ADD/SUB/MUL; STO 0 y    y := x op c
+    LLOJ,           // LOD 0 x; LIT c; OPR EQL..GEQ; JPC a         unless x rel c goto a
+    LSTO            // LIT c; STO 0 y                               y := c
+};
+
+// Instructions a superinstruction covers, including its own
+#define FUSED_LENGTH(op) ((op) == LSTO ? 2 : 4)
+
+enum symbol_kind {
+    CONSTANT = 1, VARIABLE = 2, PROCEDURE = 3
+};
+
+// Struct Definitions
+typedef struct {
+    int kind;        // const = 1, var = 2, procedure = 3
+    int ident;       // interned identifier ID (see identName)
+    int val;         // value for constants
+    int level;       // scope level
+    int addr;        // address (a procedure's: the word address of its code)
+    int mark;        // marked for deletion (set when its scope is exited)
+    int shadow;      // visible symbol with the same name before this one, -1 if none
+} symbol;
+
+typedef struct {
+    int op;          // operation code
+    int l;           // lexicographical level
+    int m;           // modifier
+} instruction;
+
+// One error found by a compile with recovery (parser_ctx.recover)
+typedef struct {
+    int code;        // error_message() code
+    int token;       // index of the token it was found at; the token count
+                     // if it was the end of input
+} diagnostic;
+
+// Hash slot from identifier to its innermost visible symbol (open addressing)
+typedef struct {
+    int ident;       // interned identifier ID, -1 for an empty slot
+    int sym;         // index into sym_table, -1 if no declaration is visible
+} sym_slot;
+
+// Per-compilation parser state: generated code, symbol table and the
+// token cursor. Separate contexts can parse on separate threads. code,
+// sym_table and sym_hash live in mem, which parse_program() resets.
+typedef struct {
+    arena mem;
+    instruction *code;        // Grows as instructions are emitted
+    int code_index;           // Next available code index
+    int code_capacity;
+
+    symbol *sym_table;        // Grows as symbols are declared
+    int sym_index;            // Next available symbol table index
+    int sym_capacity;
+    sym_slot *sym_hash;
+    int sym_hash_size;        // power of two
+    int sym_hash_used;        // slots holding an ident
+
+    const lexeme *token_list; // Active token stream (tokens.txt or lexer table)
+    int token_count;          // Total tokens
+    int token_ptr;            // Current token index
+    int current_token;
+    int current_ident;        // Interned ID for identsym, -1 otherwise
+    int current_number_val;   // For numbersym
+
+    long long lookups;        // find_symbol() calls (--stats)
+    long long compares;       // identifiers compared while probing sym_hash
+
+    int error_flag;           // Set when the compile stops on an error
+    const char *error_msg;    // Message for the first error
+    jmp_buf on_error;         // error() jumps back to parse_program()
+
+    int recover;              // set by the caller: report every error (below)
+    diagnostic *diags;        // errors found, in token order (in mem)
+    int diag_count;
+    int diag_capacity;
+    int last_error_token;     // a second error at the same token isn't reported
+} parser_ctx;
+
+void parser_init(parser_ctx *p);
+void parser_free(parser_ctx *p);
+
+// Read a token file in the tokens.txt format into lc->table (a fresh
+// compilation; identifiers interned in lc) with one pass over its mmap'd
+// text; the result is what fscanf() token by token would give. Returns
+// the number of tokens, or -1 if the file can't be opened.
+int read_token_file(lexContext *lc, const char *path);
+
+// Parse a whole token stream (from lexer() or tokens.txt) into p->code
+// (resets the previous compile); returns 0, or -1 with p->error_msg set.
+// With p->recover set, an error inside a statement or a declaration
+// section is recorded in p->diags and parsing resumes after the ; end fi
+// or . that ends it (panic mode); skipsym tokens from the lexer are
+// recorded and skipped. The compile still fails, with no code, if
+// anything was recorded.
+int parse_program(parser_ctx *p, const lexeme *tokens, int count);
+
+// Incremental compiles (incremental.c) parse the main block's body one
+// top-level statement at a time:
+//  - parse_body_start() begins a fresh compile and stops after the body's
+//    "begin": returns 1, or 0 if the body is a single statement (the
+//    whole program is parsed), or -1 on an error
+//  - parse_body_resume() moves the cursor to tokens[token], which starts
+//    a top-level statement of the previous compile, with code emitted
+//    from code_index on; the symbol table is kept
+//  - parse_body_statement() parses one statement and its separator:
+//    returns 1 if another follows, 0 once "end ." is parsed and the final
+//    SYS emitted, or -1 on an error
+// The current token is tokens[p->token_ptr - 1].
+int parse_body_start(parser_ctx *p, const lexeme *tokens, int count);
+int parse_body_resume(parser_ctx *p, const lexeme *tokens, int count, int token, int code_index);
+int parse_body_statement(parser_ctx *p);
+
+// Message printed for a parser error code (error_msg holds one of these)
+const char *error_message(int code);
+
+int find_symbol(parser_ctx *p, int ident);
+int add_symbol(parser_ctx *p, int kind, int ident, int val, int level, int addr);
+int enter_scope(parser_ctx *p);
+void exit_scope(parser_ctx *p, int first);
+
+// Listings printed by parsercodegen (names come from the lexer context)
+void print_assembly_code(const parser_ctx *p, FILE *out);
+void print_symbol_table(const parser_ctx *p, const lexContext *lc, FILE *out);
+void write_code_to_file(const parser_ctx *p, FILE *out);
+// Errors of a compile with recovery (p->recover), one per line, then the count
+void print_diagnostics(FILE *out, const parser_ctx *p, const lexContext *lc);
+
+#endif
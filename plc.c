@@ -0,0 +1,284 @@
+/*
+    plc - Batch compiler for PL/0
+
+    Compiles many PL/0 sources in one process on a work-stealing thread
+    pool. Each worker owns a lexContext and a parser_ctx and reuses them
+    for every file it compiles, so workers share nothing but the job
+    deques; files are dealt out round-robin up front and an idle worker
+    steals from the far end of another worker's deque.
+
+    To Compile:
+        gcc -O2 -std=c11 -pthread -DLEX_LIBRARY -DPARSER_LIBRARY -DOBJECT_LIBRARY -o plc plc.c parsercodegen.c lex.c optimizer.c object.c
+
+    To Execute:
+        ./plc [-j threads] [-o dir] [--optimize] [--fuse] [--object] [--stats] <source.txt>...
+    where:
+        <name>.txt compiles to <name>.elf (<name>.pmo with --object) next
+        to the source, or in dir with -o
+        -j defaults to the number of online CPUs
+        --stats prints throughput and per-thread counts to stderr
+    Notes:
+    - A file that fails to compile gets its error message in its output
+      file, as parsercodegen writes it to elf.txt; every failure is also
+      listed on stderr, in command-line order, once all files are done.
+    - Exit status is 1 if any file failed.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "parsercodegen.h"
+#include "optimizer.h"
+#include "object.h"
+
+#define MAX_THREADS 256
+
+// One source file and what happened to it
+typedef struct {
+    const char *source;
+    char *output;
+    const char *error;   // NULL on success
+    int tokens;
+    int instructions;
+} job;
+
+// Deque of job indices: the owner takes from the bottom, thieves from the top
+typedef struct {
+    pthread_mutex_t lock;
+    int *items;
+    int top, bottom;     // live items are items[top..bottom)
+} job_deque;
+
+typedef struct {
+    pthread_t thread;
+    int id;
+    job_deque deque;
+    int compiled;
+    int stolen;
+} worker;
+
+// settings and state shared by all workers (read-only once started)
+job *jobs;
+int job_count;
+worker *workers;
+int worker_count;
+int optimize = 0;
+int fuse = 0;
+int write_object = 0;
+
+
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+// <dir>/<base of source>.<ext>, or the source path with its extension replaced
+char *output_path(const char *source, const char *dir, const char *ext) {
+    const char *base = source;
+    if (dir) {
+        const char *slash = strrchr(source, '/');
+        if (slash) base = slash + 1;
+    }
+    size_t stem = strlen(base);
+    const char *dot = strrchr(base, '.');
+    if (dot && !strchr(dot, '/')) stem = (size_t)(dot - base);
+
+    size_t len = (dir ? strlen(dir) + 1 : 0) + stem + strlen(ext) + 1;
+    char *path = malloc(len);
+    if (!path) return NULL;
+    if (dir) snprintf(path, len, "%s/%.*s%s", dir, (int)stem, base, ext);
+    else snprintf(path, len, "%.*s%s", (int)stem, base, ext);
+    return path;
+}
+
+
+int deque_pop_bottom(job_deque *d) {
+    int item = -1;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top) item = d->items[--d->bottom];
+    pthread_mutex_unlock(&d->lock);
+    return item;
+}
+
+
+int deque_steal_top(job_deque *d) {
+    int item = -1;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom > d->top) item = d->items[d->top++];
+    pthread_mutex_unlock(&d->lock);
+    return item;
+}
+
+
+// next job for w: its own first, then one stolen from the other workers;
+// -1 once every deque is empty (no new jobs appear after the start)
+int next_job(worker *w) {
+    int item = deque_pop_bottom(&w->deque);
+    if (item >= 0) return item;
+    for (int k = 1; k < worker_count; k++) {
+        item = deque_steal_top(&workers[(w->id + k) % worker_count].deque);
+        if (item >= 0) {
+            w->stolen++;
+            return item;
+        }
+    }
+    return -1;
+}
+
+
+void compile_job(job *j, lexContext *lc, parser_ctx *p) {
+    FILE *out = fopen(j->output, "w");
+    if (!out) {
+        j->error = "Error: Could not open output file.";
+        return;
+    }
+
+    if (lexFile(lc, j->source) < 0) {
+        j->error = "Error: Could not open input file.";
+    } else if ((j->tokens = lc->tableIndex) == 0) {
+        j->error = "Error: source file is empty or invalid.";
+    } else if (parse_program(p, lc->table, lc->tableIndex) < 0) {
+        // a lexer error (skipsym) stops the parser without a message
+        j->error = p->error_msg ? p->error_msg : error_message(1);
+    }
+    if (j->error) {
+        fprintf(out, "%s\n", j->error);
+        fclose(out);
+        return;
+    }
+
+    if (optimize) p->code_index = optimize_code(p->code, p->code_index, NULL);
+    if (fuse) fuse_code(p->code, p->code_index, NULL);
+    j->instructions = p->code_index;
+
+    if (write_object) {
+        fclose(out);
+        const char **names = malloc((size_t)p->sym_index * sizeof(char *) + 1);
+        for (int i = 0; names && i < p->sym_index; i++) names[i] = identName(lc, p->sym_table[i].ident);
+        if (!names || obj_write(j->output, p->code, p->code_index, p->sym_table, p->sym_index, names) < 0) {
+            j->error = "Error: Could not write object file.";
+        }
+        free(names);
+        return;
+    }
+    write_code_to_file(p, out);
+    if (fclose(out) != 0) j->error = "Error: Could not write output file.";
+}
+
+
+void *worker_main(void *arg) {
+    worker *w = arg;
+    lexContext lc;
+    parser_ctx p;
+    lexInit(&lc);
+    parser_init(&p);
+
+    // each compile resets both arenas, so after the first few files a
+    // worker compiles without calling malloc
+    int item;
+    while ((item = next_job(w)) >= 0) {
+        compile_job(&jobs[item], &lc, &p);
+        w->compiled++;
+    }
+
+    parser_free(&p);
+    lexFree(&lc);
+    return NULL;
+}
+
+
+int main(int argc, char *argv[]) {
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *dir = NULL;
+    int show_stats = 0;
+    jobs = malloc((size_t)argc * sizeof(job));
+    if (!jobs) return EXIT_FAILURE;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) threads = atol(argv[++i]);
+        else if (strncmp(argv[i], "-j", 2) == 0 && argv[i][2]) threads = atol(argv[i] + 2);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) dir = argv[++i];
+        else if (strcmp(argv[i], "--optimize") == 0) optimize = 1;
+        else if (strcmp(argv[i], "--fuse") == 0) fuse = 1;
+        else if (strcmp(argv[i], "--object") == 0) write_object = 1;
+        else if (strcmp(argv[i], "--stats") == 0) show_stats = 1;
+        else {
+            memset(&jobs[job_count], 0, sizeof(job));
+            jobs[job_count++].source = argv[i];
+        }
+    }
+    if (job_count == 0) {
+        fprintf(stderr, "Usage: %s [-j threads] [-o dir] [--optimize] [--fuse] [--object] [--stats] <source.txt>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < job_count; i++) {
+        jobs[i].output = output_path(jobs[i].source, dir, write_object ? ".pmo" : ".elf");
+        if (!jobs[i].output) return EXIT_FAILURE;
+    }
+
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if (threads > job_count) threads = job_count;
+    worker_count = (int)threads;
+    workers = calloc((size_t)worker_count, sizeof(worker));
+    if (!workers) return EXIT_FAILURE;
+
+    // deal the files out round-robin; stealing evens out uneven sizes
+    for (int w = 0; w < worker_count; w++) {
+        workers[w].id = w;
+        pthread_mutex_init(&workers[w].deque.lock, NULL);
+        workers[w].deque.items = malloc((size_t)(job_count / worker_count + 1) * sizeof(int));
+        if (!workers[w].deque.items) return EXIT_FAILURE;
+    }
+    for (int i = job_count - 1; i >= 0; i--) {
+        job_deque *d = &workers[i % worker_count].deque;
+        d->items[d->bottom++] = i; // popped from the bottom, so file order is kept
+    }
+
+    selectScanners(); // once, before the workers start lexing
+    double start = now_seconds();
+    for (int w = 1; w < worker_count; w++) {
+        if (pthread_create(&workers[w].thread, NULL, worker_main, &workers[w]) != 0) {
+            fprintf(stderr, "Error: could not start thread %d\n", w);
+            return EXIT_FAILURE;
+        }
+    }
+    worker_main(&workers[0]);
+    for (int w = 1; w < worker_count; w++) pthread_join(workers[w].thread, NULL);
+    double elapsed = now_seconds() - start;
+
+    int failed = 0;
+    long long tokens = 0, instructions = 0;
+    for (int i = 0; i < job_count; i++) {
+        tokens += jobs[i].tokens;
+        instructions += jobs[i].instructions;
+        if (jobs[i].error) {
+            fprintf(stderr, "%s: %s\n", jobs[i].source, jobs[i].error);
+            failed++;
+        }
+    }
+
+    if (show_stats) {
+        fprintf(stderr, "%d files (%d failed) on %d threads in %.3f s: %.0f files/s, %.2f Mtokens/s, %lld instructions\n",
+                job_count, failed, worker_count, elapsed, job_count / elapsed, tokens / elapsed / 1e6, instructions);
+        for (int w = 0; w < worker_count; w++) {
+            fprintf(stderr, "  thread %2d: %d compiled, %d stolen\n", w, workers[w].compiled, workers[w].stolen);
+        }
+    }
+
+    for (int w = 0; w < worker_count; w++) {
+        pthread_mutex_destroy(&workers[w].deque.lock);
+        free(workers[w].deque.items);
+    }
+    for (int i = 0; i < job_count; i++) free(jobs[i].output);
+    free(workers);
+    free(jobs);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
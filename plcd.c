@@ -0,0 +1,357 @@
+/*
+    plcd - Compile daemon for PL/0
+
+    Keeps the compiler warm in one long-running process: clients send
+    PL/0 source over a Unix domain socket and get the PM/0 code (or the
+    error messages) back in a framed binary reply (plcd.h), with no
+    process start-up and no tokens.txt / elf.txt round trip.
+
+    To Compile:
+        gcc -O2 -std=c11 -pthread -DLEX_LIBRARY -DPARSER_LIBRARY -DOBJECT_LIBRARY -o plcd plcd.c parsercodegen.c lex.c optimizer.c object.c
+
+    To Execute:
+        ./plcd [-j contexts] [--stats] <socket path>
+    where:
+        -j is the number of compile contexts, i.e. compiles that can run
+        at once (default: the number of online CPUs)
+        --stats prints request counts and compile time to stderr on exit
+    Notes:
+    - Every connection gets its own thread, which reads requests and
+      sends replies in order. A request borrows a compile context (a
+      lexContext, a parser_ctx and the reply buffers) from a pool and
+      gives it back once its reply is sent; the contexts keep their
+      arenas, so after warm-up a compile does no malloc.
+    - A compile is lexer() + parse_program(), then optimize_code() and
+      fuse_code() if the request asks, exactly as parsercodegen <source>
+      does; the code is sent packed as in .pmo files (object.h).
+    - SIGINT / SIGTERM stop the daemon and remove the socket.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "parsercodegen.h"
+#include "optimizer.h"
+#include "object.h"
+#include "plcd.h"
+
+#define MAX_CONTEXTS 256
+
+// One compile's worth of reusable state
+typedef struct compile_ctx {
+    lexContext lc;
+    parser_ctx p;
+    uint32_t *words;          // packed code of the reply
+    int32_t *pool;
+    int capacity;             // entries in words and pool
+    char *text;               // error text of the reply (open_memstream buffer)
+    size_t text_size;
+    struct compile_ctx *next; // free list
+} compile_ctx;
+
+// context pool, shared by all connections
+compile_ctx *contexts;
+int context_count;
+compile_ctx *free_contexts;
+pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t pool_available = PTHREAD_COND_INITIALIZER;
+
+// --stats counters (under pool_lock)
+long long requests, failures, connections, source_bytes;
+double compile_seconds;
+
+volatile sig_atomic_t stopping = 0;
+
+
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+compile_ctx *acquire_context() {
+    pthread_mutex_lock(&pool_lock);
+    while (!free_contexts) pthread_cond_wait(&pool_available, &pool_lock);
+    compile_ctx *c = free_contexts;
+    free_contexts = c->next;
+    pthread_mutex_unlock(&pool_lock);
+    return c;
+}
+
+
+void release_context(compile_ctx *c, int failed, size_t bytes, double seconds) {
+    pthread_mutex_lock(&pool_lock);
+    c->next = free_contexts;
+    free_contexts = c;
+    requests++;
+    failures += failed;
+    source_bytes += (long long)bytes;
+    compile_seconds += seconds;
+    pthread_cond_signal(&pool_available);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+
+// the reply text is msg and a newline
+void set_error_text(compile_ctx *c, const char *msg) {
+    free(c->text);
+    c->text_size = strlen(msg) + 1;
+    c->text = malloc(c->text_size);
+    if (!c->text) {
+        c->text_size = 0;
+        return;
+    }
+    memcpy(c->text, msg, c->text_size - 1);
+    c->text[c->text_size - 1] = '\n';
+}
+
+
+// compile source into c's reply buffers and fill in reply
+void compile_source(compile_ctx *c, const char *source, uint32_t flags, plcd_reply *reply) {
+    lexContext *lc = &c->lc;
+    parser_ctx *p = &c->p;
+    memset(reply, 0, sizeof(*reply));
+    reply->magic = PLCD_MAGIC;
+    reply->status = PLCD_COMPILE_ERROR;
+    c->text_size = 0;
+
+    lexer(lc, source);
+    if (lc->tableIndex == 0) {
+        set_error_text(c, "Error: source file is empty or invalid.");
+    } else {
+        p->recover = (flags & PLCD_ALL_ERRORS) != 0;
+        if (parse_program(p, lc->table, lc->tableIndex) < 0) {
+            if (p->recover && p->diag_count > 0) {
+                free(c->text);
+                c->text = NULL;
+                FILE *out = open_memstream(&c->text, &c->text_size);
+                if (out) {
+                    print_diagnostics(out, p, lc);
+                    fclose(out);
+                } else {
+                    c->text_size = 0;
+                }
+            } else {
+                // a lexer error (skipsym) stops the parser without a message
+                set_error_text(c, p->error_msg ? p->error_msg : error_message(1));
+            }
+        } else {
+            if (flags & PLCD_OPTIMIZE) p->code_index = optimize_code(p->code, p->code_index, NULL);
+            if (flags & PLCD_FUSE) fuse_code(p->code, p->code_index, NULL);
+            if (p->code_index > c->capacity) {
+                int capacity = c->capacity ? c->capacity : 1024;
+                while (capacity < p->code_index) capacity *= 2;
+                uint32_t *words = realloc(c->words, (size_t)capacity * sizeof(uint32_t));
+                if (words) c->words = words;
+                int32_t *pool = realloc(c->pool, (size_t)capacity * sizeof(int32_t));
+                if (pool) c->pool = pool;
+                if (words && pool) c->capacity = capacity;
+            }
+            int pool_count = -1;
+            if (p->code_index <= c->capacity) {
+                pool_count = obj_pack_code(p->code, p->code_index, c->words, c->pool);
+            }
+            if (pool_count < 0) {
+                set_error_text(c, "Error: the code can't be packed (nesting deeper than 15 levels?)");
+            } else {
+                reply->status = PLCD_OK;
+                reply->code_count = (uint32_t)p->code_index;
+                reply->pool_count = (uint32_t)pool_count;
+            }
+        }
+    }
+    if (reply->status != PLCD_OK) reply->text_size = (uint32_t)c->text_size;
+}
+
+
+// read exactly size bytes; 1 on success, 0 on end of input before the
+// first byte, -1 on an error or a short read
+int read_full(int fd, void *buf, size_t size) {
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = read(fd, (char *)buf + got, size - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return n == 0 && got == 0 ? 0 : -1;
+        got += (size_t)n;
+    }
+    return 1;
+}
+
+
+// write all of iov[0..count) (adjusting it as it goes); 0 or -1
+int write_full(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+
+// answer requests on one connection until the client closes it
+void *serve_connection(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    char *source = NULL;
+    size_t source_cap = 0;
+    plcd_request req;
+
+    while (read_full(fd, &req, sizeof(req)) > 0) {
+        plcd_reply reply;
+        if (req.magic != PLCD_MAGIC || req.source_size > PLCD_MAX_SOURCE) {
+            memset(&reply, 0, sizeof(reply));
+            reply.magic = PLCD_MAGIC;
+            reply.status = PLCD_BAD_REQUEST;
+            struct iovec iov = {&reply, sizeof(reply)};
+            write_full(fd, &iov, 1);
+            break;
+        }
+        if (req.source_size + 1 > source_cap) {
+            size_t cap = source_cap ? source_cap : 65536;
+            while (cap < req.source_size + 1) cap *= 2;
+            char *grown = realloc(source, cap);
+            if (!grown) break;
+            source = grown;
+            source_cap = cap;
+        }
+        if (read_full(fd, source, req.source_size) < 0) break;
+        source[req.source_size] = '\0';
+
+        compile_ctx *c = acquire_context();
+        double start = now_seconds();
+        compile_source(c, source, req.flags, &reply);
+        double seconds = now_seconds() - start;
+        struct iovec iov[4] = {
+            {&reply, sizeof(reply)},
+            {c->words, reply.code_count * sizeof(uint32_t)},
+            {c->pool, reply.pool_count * sizeof(int32_t)},
+            {c->text, reply.text_size},
+        };
+        int sent = write_full(fd, iov, 4);
+        release_context(c, reply.status != PLCD_OK, req.source_size, seconds);
+        if (sent < 0) break;
+    }
+
+    close(fd);
+    free(source);
+    return NULL;
+}
+
+
+void on_signal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+
+int main(int argc, char *argv[]) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *path = NULL;
+    int show_stats = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) count = atol(argv[++i]);
+        else if (strncmp(argv[i], "-j", 2) == 0 && argv[i][2]) count = atol(argv[i] + 2);
+        else if (strcmp(argv[i], "--stats") == 0) show_stats = 1;
+        else path = argv[i];
+    }
+    struct sockaddr_un addr;
+    if (!path || strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Usage: %s [-j contexts] [--stats] <socket path>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (count < 1) count = 1;
+    if (count > MAX_CONTEXTS) count = MAX_CONTEXTS;
+    context_count = (int)count;
+    contexts = calloc((size_t)context_count, sizeof(compile_ctx));
+    if (!contexts) return EXIT_FAILURE;
+    for (int i = 0; i < context_count; i++) {
+        lexInit(&contexts[i].lc);
+        parser_init(&contexts[i].p);
+        contexts[i].next = free_contexts;
+        free_contexts = &contexts[i];
+    }
+    selectScanners(); // once, before any connection thread lexes
+
+    // a socket left behind by an earlier run is replaced, any other file kept
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 128) < 0) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+
+    // the signals go to this thread (connection threads block them), and
+    // without SA_RESTART they interrupt accept()
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN); // a client that goes away is just a failed write
+    sigset_t stop_signals, old_mask;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+
+    pthread_attr_t detached;
+    pthread_attr_init(&detached);
+    pthread_attr_setdetachstate(&detached, PTHREAD_CREATE_DETACHED);
+    while (!stopping) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EINTR) perror("accept");
+            continue;
+        }
+        pthread_t thread;
+        pthread_sigmask(SIG_BLOCK, &stop_signals, &old_mask);
+        int failed = pthread_create(&thread, &detached, serve_connection, (void *)(intptr_t)fd);
+        pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+        if (failed) {
+            fprintf(stderr, "Error: could not start a connection thread\n");
+            close(fd);
+            continue;
+        }
+        pthread_mutex_lock(&pool_lock);
+        connections++;
+        pthread_mutex_unlock(&pool_lock);
+    }
+
+    close(listen_fd);
+    unlink(path);
+    if (show_stats) {
+        pthread_mutex_lock(&pool_lock);
+        fprintf(stderr, "plcd: %lld connections, %lld requests (%lld failed), %.1f MB of source, "
+                "%.3f s compiling (%.1f us per request) on %d contexts\n",
+                connections, requests, failures, source_bytes / 1048576.0, compile_seconds,
+                requests ? compile_seconds / requests * 1e6 : 0, context_count);
+        pthread_mutex_unlock(&pool_lock);
+    }
+    // connection threads still running are ended by the exit
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,55 @@
+/*
+    plcd.h - Wire protocol of the plcd compile daemon
+
+    A client connects to plcd's Unix domain socket and sends any number
+    of requests on the connection, each answered by one reply, in order.
+    All fields are in the byte order of the machine (the socket is
+    local) and every frame is a fixed header followed by its payload:
+
+        request:  plcd_request, then source_size bytes of PL/0 source
+        reply:    plcd_reply, then
+                      code     uint32_t[code_count]   packed as in object.h
+                      pool     int32_t[pool_count]    LIT values too wide for a word
+                      text     char[text_size]        error or diagnostics, not NUL-terminated
+
+    A successful compile has code and no text; a failed one has no code
+    and the text parsercodegen would write to elf.txt (the error message,
+    or with PLCD_ALL_ERRORS every error and the count). A bad request
+    gets PLCD_BAD_REQUEST and the connection is closed.
+*/
+
+#ifndef PLCD_H
+#define PLCD_H
+
+#include <stdint.h>
+
+#define PLCD_MAGIC 0x44434c50u      // "PLCD" read as a little-endian word
+#define PLCD_MAX_SOURCE (64u << 20) // largest source accepted
+
+// plcd_request.flags
+#define PLCD_OPTIMIZE 0x1           // parsercodegen --optimize
+#define PLCD_FUSE 0x2               // parsercodegen --fuse
+#define PLCD_ALL_ERRORS 0x4         // parsercodegen --all-errors
+
+// plcd_reply.status
+enum plcd_status {
+    PLCD_OK = 0,
+    PLCD_COMPILE_ERROR = 1,
+    PLCD_BAD_REQUEST = 2
+};
+
+typedef struct {
+    uint32_t magic;         // PLCD_MAGIC
+    uint32_t flags;
+    uint32_t source_size;   // at most PLCD_MAX_SOURCE
+} plcd_request;
+
+typedef struct {
+    uint32_t magic;         // PLCD_MAGIC
+    uint32_t status;        // enum plcd_status
+    uint32_t code_count;
+    uint32_t pool_count;
+    uint32_t text_size;
+} plcd_reply;
+
+#endif
@@ -0,0 +1,519 @@
+/*
+    vm - PM/0 Virtual Machine
+
+    Executes the PM/0 code written by parsercodegen.c (elf.txt, or a .pmo
+    object file, which is mmap'd and decoded in place). Code is
+    decoded once into a flat array and run with a direct-threaded
+    dispatch loop (computed goto); compilers without computed goto, or
+    builds with -DVM_SWITCH_DISPATCH, use a switch loop instead.
+    Superinstructions (parsercodegen --fuse) run their whole sequence in
+    one dispatch.
+
+    To Compile:
+        gcc -O2 -std=c11 -DOBJECT_LIBRARY -o vm vm.c jit.c object.c
+    or, with the switch dispatch loop:
+        gcc -O2 -std=c11 -DOBJECT_LIBRARY -DVM_SWITCH_DISPATCH -o vm vm.c jit.c object.c
+
+    To Execute:
+        ./vm [--stats] [--jit] [code file]
+    where:
+        [code file] is the elf.txt written by parsercodegen (default elf.txt)
+                    or a .pmo object (see object.h)
+        --stats reports instructions executed and instructions/second
+                (a superinstruction counts once)
+        --jit compiles the code to x86-64 first (jit.c); falls back to
+              the interpreter when the JIT can't handle the code
+    Notes:
+    - Follows the PM/0 ISA (Appendix A): the stack grows down, an
+      activation record is [static link, dynamic link, return address,
+      locals...] starting at bp, and JMP/JPC/CAL targets are word
+      addresses (3 * instruction index).
+    - Non-local frames are found through a display (one base per static
+      level, kept up to date by CAL and RTN) instead of following L
+      static links on every LOD/STO/CAL; the static links are still
+      written, so the frames look the same.
+    - SYS 0 1 prints the top of the stack on its own line; SYS 0 2 reads
+      an integer from stdin (0 at end of input).
+    - Hand-written code can't reach outside the VM's memory: LOD/STO
+      operands are checked when decoding, and pushes, pops, CAL and RTN
+      as they run (stack overflow, stack underflow, overwritten links).
+    - Arithmetic wraps around instead of overflowing, and INT_MIN / -1 is
+      INT_MIN (see opr_div() in parsercodegen.h).
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vm.h"
+#include "jit.h"
+
+#define CODE_FILENAME "elf.txt"
+
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define VM_THREADED 1
+#endif
+
+// Decoded operations: OPR and SYS are split per sub-operation and
+// LOD/STO with L = 0 get their own entries, so each handler does one job.
+// LLOS and LLOJ likewise get one entry per OPR.
+enum vm_op {
+    V_LIT, V_RTN, V_ADD, V_SUB, V_MUL, V_DIV, V_EQL, V_NEQ, V_LSS, V_LEQ,
+    V_GTR, V_GEQ, V_EVEN, V_LOD0, V_LOD, V_STO0, V_STO, V_CAL, V_INC,
+    V_JMP, V_JPC, V_WRITE, V_READ, V_HALT,
+    V_LLOS_ADD, V_LLOS_SUB, V_LLOS_MUL,
+    V_LLOJ_EQL, V_LLOJ_NEQ, V_LLOJ_LSS, V_LLOJ_LEQ, V_LLOJ_GTR, V_LLOJ_GEQ,
+    V_LSTO, V_OP_COUNT
+};
+
+typedef struct {
+#ifdef VM_THREADED
+    const void *handler; // address of the handler for op
+#endif
+    int op;              // enum vm_op
+    int l;               // static levels down (LOD/STO/CAL)
+    int m;               // operand; jump/call targets as instruction indices
+    int n;               // superinstructions: l is the variable loaded, m
+                         // the literal and n the variable stored or the
+                         // jump target
+} vm_insn;
+
+
+double vm_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+// a static level and a frame offset the VM can address: deeper levels
+// than calls can be active aren't accepted, and offsets stay within the
+// stack's slack (see vm_exec())
+static int vm_valid_operand(int l, int m) {
+    return l >= 0 && l <= VM_MAX_CALLS && m >= 0 && m < VM_STACK_SIZE;
+}
+
+// translate one PM/0 instruction; returns -1 if it isn't valid
+int vm_decode(const instruction *in, int count, vm_insn *out) {
+    out->l = in->l;
+    out->m = in->m;
+    switch (in->op) {
+        case LIT: out->op = V_LIT; return 0;
+        case OPR:
+            if (in->m < RTN || in->m > EVEN) return -1;
+            out->op = V_RTN + in->m;
+            return 0;
+        case LOD:
+            if (!vm_valid_operand(in->l, in->m)) return -1;
+            out->op = in->l == 0 ? V_LOD0 : V_LOD;
+            return 0;
+        case STO:
+            if (!vm_valid_operand(in->l, in->m)) return -1;
+            out->op = in->l == 0 ? V_STO0 : V_STO;
+            return 0;
+        case INC:
+            if (in->m < 0) return -1;
+            out->op = V_INC;
+            return 0;
+        case CAL:
+        case JMP:
+        case JPC:
+            // a target of `count` runs off the end, which halts
+            if (in->m % 3 != 0 || in->m < 0 || CODE_INDEX(in->m) > count) return -1;
+            if (in->op == CAL && !vm_valid_operand(in->l, 0)) return -1;
+            out->op = in->op == CAL ? V_CAL : in->op == JMP ? V_JMP : V_JPC;
+            out->m = CODE_INDEX(in->m);
+            return 0;
+        case SYS:
+            if (in->m == SYS_WRITE) out->op = V_WRITE;
+            else if (in->m == SYS_READ) out->op = V_READ;
+            else if (in->m == SYS_HALT) out->op = V_HALT;
+            else return -1;
+            return 0;
+        // the rest of the sequence is read by vm_link_fused()
+        case LLOS:
+        case LLOJ:
+            if (in->l != 0 || !vm_valid_operand(0, in->m)) return -1;
+            out->op = in->op == LLOS ? V_LLOS_ADD : V_LLOJ_EQL;
+            out->l = in->m;
+            return 0;
+        case LSTO:
+            out->op = V_LSTO;
+            return 0;
+    }
+    return -1;
+}
+
+
+// complete each superinstruction from the instructions it covers, which
+// were decoded as themselves (a jump into the sequence runs them);
+// returns the index of one that doesn't cover its sequence, or -1
+static int vm_link_fused(vm_insn *prog, int count) {
+    for (int i = 0; i < count; i++) {
+        vm_insn *in = &prog[i];
+        if (in->op == V_LLOS_ADD || in->op == V_LLOJ_EQL) {
+            if (i + 3 >= count || prog[i + 1].op != V_LIT) return i;
+            int opr = prog[i + 2].op, last = prog[i + 3].op;
+            if (in->op == V_LLOS_ADD) {
+                if (opr < V_ADD || opr > V_MUL || last != V_STO0) return i;
+                in->op = V_LLOS_ADD + (opr - V_ADD);
+            } else {
+                if (opr < V_EQL || opr > V_GEQ || last != V_JPC) return i;
+                in->op = V_LLOJ_EQL + (opr - V_EQL);
+            }
+            in->m = prog[i + 1].m;
+            in->n = prog[i + 3].m;
+        } else if (in->op == V_LSTO) {
+            if (i + 1 >= count || prog[i + 1].op != V_STO0) return i;
+            in->n = prog[i + 1].m;
+        }
+    }
+    return -1;
+}
+
+
+// Display: frame[-l] is the base of the activation record l static
+// levels down (what following l static links from bp would give), frame
+// pointing at the current level's entry. Below main's entry there are
+// max_l more copies of main's base, since its static link is itself.
+// CAL from frame with L = l makes its frame the entry at frame - l + 1,
+// saving the entry it replaces for RTN to put back.
+typedef struct {
+    int *frame;          // the caller's display entry
+    int replaced;        // base that was in the callee's entry
+} vm_call;
+
+
+// run decoded code prog[0..count]; prog[count] must be free for the halt sentinel
+static int vm_exec(vm_insn *prog, int count, vm_stats *stats) {
+    int bad = vm_link_fused(prog, count);
+    if (bad >= 0) {
+        fprintf(stderr, "Error: superinstruction %d doesn't match the code after it\n", bad);
+        return VM_BAD_CODE;
+    }
+
+    // variables start at 0, as in PM/0. bp is always a stack index and
+    // LOD/STO offsets are below VM_STACK_SIZE, so with as many words of
+    // slack under stack[0] bp - m needs no check at run time
+    int *memory = calloc(2 * (size_t)VM_STACK_SIZE, sizeof(int));
+    if (!memory) {
+        fprintf(stderr, "Error: out of memory for the VM.\n");
+        return VM_STACK_OVERFLOW;
+    }
+    int *const stack = memory + VM_STACK_SIZE;
+
+    prog[count].op = V_HALT; // running off the end halts
+    prog[count].l = prog[count].m = 0;
+
+    // frames can use the whole stack: INC and CAL check that theirs fits
+    // and every push that there's room for it
+    int sp = VM_STACK_SIZE, bp = sp - 1, pc = 0;
+    // main's activation record: links to itself, and RTN from it halts
+    stack[bp] = bp;
+    stack[bp - 1] = bp;
+    stack[bp - 2] = count;
+
+    // CAL itself doesn't move sp (the callee's INC does), so code that
+    // calls without an INC isn't bounded by the stack; CAL counts the
+    // calls active and stops at max_calls, which is as many as the stack
+    // holds when every callee reserves its 3-word activation record
+    int max_l = 0, max_calls = VM_MAX_CALLS;
+    for (int i = 0; i < count; i++) {
+        if ((prog[i].op == V_LOD || prog[i].op == V_STO || prog[i].op == V_CAL) && prog[i].l > max_l) max_l = prog[i].l;
+    }
+    int *display = malloc((size_t)(max_l + max_calls + 1) * sizeof(int));
+    vm_call *calls = malloc((size_t)max_calls * sizeof(vm_call));
+    if (!display || !calls) {
+        fprintf(stderr, "Error: out of memory for the VM.\n");
+        free(memory);
+        free(display);
+        free(calls);
+        return VM_STACK_OVERFLOW;
+    }
+    int *const main_frame = display + max_l;
+    for (int i = 0; i <= max_l; i++) display[i] = bp;
+    int *frame = main_frame;
+    vm_call *call = calls;
+    long long executed = 0;
+    int status = VM_OK;
+    const vm_insn *ip;
+    double start = vm_now();
+
+    // hand-written code can push past the bottom of the stack or pop
+    // more than was pushed
+#define PUSH_ROOM() do { if (sp == 0) { status = VM_STACK_OVERFLOW; goto done; } } while (0)
+#define POPS(n) do { if (sp > VM_STACK_SIZE - (n)) { status = VM_STACK_UNDERFLOW; goto done; } } while (0)
+#ifdef VM_THREADED
+    static const void *handlers[V_OP_COUNT] = {
+        &&do_LIT, &&do_RTN, &&do_ADD, &&do_SUB, &&do_MUL, &&do_DIV, &&do_EQL,
+        &&do_NEQ, &&do_LSS, &&do_LEQ, &&do_GTR, &&do_GEQ, &&do_EVEN, &&do_LOD0,
+        &&do_LOD, &&do_STO0, &&do_STO, &&do_CAL, &&do_INC, &&do_JMP, &&do_JPC,
+        &&do_WRITE, &&do_READ, &&do_HALT, &&do_LLOS_ADD, &&do_LLOS_SUB,
+        &&do_LLOS_MUL, &&do_LLOJ_EQL, &&do_LLOJ_NEQ, &&do_LLOJ_LSS, &&do_LLOJ_LEQ,
+        &&do_LLOJ_GTR, &&do_LLOJ_GEQ, &&do_LSTO
+    };
+    for (int i = 0; i <= count; i++) prog[i].handler = handlers[prog[i].op];
+
+#define CASE(name) do_##name:
+#define NEXT() do { ip = &prog[pc++]; executed++; goto *ip->handler; } while (0)
+    NEXT();
+    {
+#else
+#define CASE(name) case V_##name:
+#define NEXT() continue
+    for (;;) {
+        ip = &prog[pc++];
+        executed++;
+        switch (ip->op) {
+#endif
+        CASE(LIT)  PUSH_ROOM(); stack[--sp] = ip->m; NEXT();
+        CASE(RTN)
+            sp = bp + 1;
+            bp = stack[sp - 2];
+            pc = stack[sp - 3];
+            if ((unsigned)bp >= VM_STACK_SIZE || (unsigned)pc > (unsigned)count) { // overwritten links
+                status = VM_BAD_CODE;
+                goto done;
+            }
+            if (call > calls) { // not main's RTN, which halts
+                call--;
+                *frame = call->replaced;
+                frame = call->frame;
+            }
+            NEXT();
+        CASE(ADD)  POPS(2); sp++; stack[sp] = (int)((unsigned)stack[sp] + (unsigned)stack[sp - 1]); NEXT();
+        CASE(SUB)  POPS(2); sp++; stack[sp] = (int)((unsigned)stack[sp] - (unsigned)stack[sp - 1]); NEXT();
+        CASE(MUL)  POPS(2); sp++; stack[sp] = (int)((unsigned)stack[sp] * (unsigned)stack[sp - 1]); NEXT();
+        CASE(DIV)
+            POPS(2);
+            if (stack[sp] == 0) {
+                status = VM_DIVIDE_BY_ZERO;
+                goto done;
+            }
+            sp++; stack[sp] = opr_div(stack[sp], stack[sp - 1]); NEXT();
+        CASE(EQL)  POPS(2); sp++; stack[sp] = stack[sp] == stack[sp - 1]; NEXT();
+        CASE(NEQ)  POPS(2); sp++; stack[sp] = stack[sp] != stack[sp - 1]; NEXT();
+        CASE(LSS)  POPS(2); sp++; stack[sp] = stack[sp] < stack[sp - 1]; NEXT();
+        CASE(LEQ)  POPS(2); sp++; stack[sp] = stack[sp] <= stack[sp - 1]; NEXT();
+        CASE(GTR)  POPS(2); sp++; stack[sp] = stack[sp] > stack[sp - 1]; NEXT();
+        CASE(GEQ)  POPS(2); sp++; stack[sp] = stack[sp] >= stack[sp - 1]; NEXT();
+        CASE(EVEN) POPS(1); stack[sp] = stack[sp] % 2 == 0; NEXT();
+        CASE(LOD0) PUSH_ROOM(); stack[sp - 1] = stack[bp - ip->m]; sp--; NEXT();
+        CASE(LOD)  PUSH_ROOM(); stack[sp - 1] = stack[frame[-ip->l] - ip->m]; sp--; NEXT();
+        CASE(STO0) POPS(1); stack[bp - ip->m] = stack[sp++]; NEXT();
+        CASE(STO)  POPS(1); stack[frame[-ip->l] - ip->m] = stack[sp++]; NEXT();
+        CASE(CAL)
+        {
+            if (sp < 3 || call == calls + max_calls) {
+                status = VM_STACK_OVERFLOW;
+                goto done;
+            }
+            int *parent = frame - ip->l;
+            if (parent < main_frame) parent = main_frame; // past main: main
+            stack[sp - 1] = *parent;
+            stack[sp - 2] = bp;
+            stack[sp - 3] = pc;
+            bp = sp - 1;
+            pc = ip->m;
+            call->frame = frame;
+            call->replaced = parent[1];
+            call++;
+            frame = parent + 1;
+            *frame = bp;
+            NEXT();
+        }
+        CASE(INC)
+            sp -= ip->m;
+            if (sp < 0) {
+                status = VM_STACK_OVERFLOW;
+                goto done;
+            }
+            NEXT();
+        CASE(JMP)  pc = ip->m; NEXT();
+        CASE(JPC)  POPS(1); if (stack[sp++] == 0) pc = ip->m; NEXT();
+        CASE(WRITE) POPS(1); printf("%d\n", stack[sp++]); NEXT();
+        CASE(READ)
+        {
+            int value;
+            if (scanf("%d", &value) != 1) value = 0;
+            PUSH_ROOM();
+            stack[--sp] = value;
+            NEXT();
+        }
+        CASE(HALT) goto done;
+        // superinstructions; pc already points past the first instruction
+        CASE(LLOS_ADD) stack[bp - ip->n] = (int)((unsigned)stack[bp - ip->l] + (unsigned)ip->m); pc += 3; NEXT();
+        CASE(LLOS_SUB) stack[bp - ip->n] = (int)((unsigned)stack[bp - ip->l] - (unsigned)ip->m); pc += 3; NEXT();
+        CASE(LLOS_MUL) stack[bp - ip->n] = (int)((unsigned)stack[bp - ip->l] * (unsigned)ip->m); pc += 3; NEXT();
+        CASE(LLOJ_EQL) pc = stack[bp - ip->l] == ip->m ? pc + 3 : ip->n; NEXT();
+        CASE(LLOJ_NEQ) pc = stack[bp - ip->l] != ip->m ? pc + 3 : ip->n; NEXT();
+        CASE(LLOJ_LSS) pc = stack[bp - ip->l] < ip->m ? pc + 3 : ip->n; NEXT();
+        CASE(LLOJ_LEQ) pc = stack[bp - ip->l] <= ip->m ? pc + 3 : ip->n; NEXT();
+        CASE(LLOJ_GTR) pc = stack[bp - ip->l] > ip->m ? pc + 3 : ip->n; NEXT();
+        CASE(LLOJ_GEQ) pc = stack[bp - ip->l] >= ip->m ? pc + 3 : ip->n; NEXT();
+        CASE(LSTO) stack[bp - ip->n] = ip->m; pc += 1; NEXT();
+#ifndef VM_THREADED
+        default: goto done;
+        }
+#endif
+    }
+#undef CASE
+#undef NEXT
+#undef PUSH_ROOM
+#undef POPS
+
+done:
+    fflush(stdout);
+    if (status == VM_STACK_OVERFLOW) {
+        fprintf(stderr, "Error: stack overflow\n");
+    } else if (status == VM_DIVIDE_BY_ZERO) {
+        fprintf(stderr, "Error: division by zero\n");
+    } else if (status == VM_STACK_UNDERFLOW) {
+        fprintf(stderr, "Error: stack underflow\n");
+    } else if (status == VM_BAD_CODE) {
+        fprintf(stderr, "Error: RTN to an overwritten return address or dynamic link\n");
+    }
+    if (stats) {
+        stats->instructions = executed;
+        stats->seconds = vm_now() - start;
+    }
+    free(memory);
+    free(display);
+    free(calls);
+    return status;
+}
+
+
+int vm_run(const instruction *code, int count, vm_stats *stats) {
+    vm_insn *prog = malloc((size_t)(count + 1) * sizeof(vm_insn));
+    if (!prog) {
+        fprintf(stderr, "Error: out of memory for the VM.\n");
+        return VM_STACK_OVERFLOW;
+    }
+    for (int i = 0; i < count; i++) {
+        if (vm_decode(&code[i], count, &prog[i]) < 0) {
+            fprintf(stderr, "Error: invalid instruction %d: %d %d %d\n", i, code[i].op, code[i].l, code[i].m);
+            free(prog);
+            return VM_BAD_CODE;
+        }
+    }
+    int status = vm_exec(prog, count, stats);
+    free(prog);
+    return status;
+}
+
+
+int vm_run_object(const obj_file *obj, vm_stats *stats) {
+    int count = (int)obj->header->code_count;
+    vm_insn *prog = malloc((size_t)(count + 1) * sizeof(vm_insn));
+    if (!prog) {
+        fprintf(stderr, "Error: out of memory for the VM.\n");
+        return VM_STACK_OVERFLOW;
+    }
+    // decode straight from the mapped words; no text or instruction[] step
+    for (int i = 0; i < count; i++) {
+        instruction in;
+        if (obj_unpack(obj, i, &in) < 0 || vm_decode(&in, count, &prog[i]) < 0) {
+            fprintf(stderr, "Error: invalid instruction %d in object code\n", i);
+            free(prog);
+            return VM_BAD_CODE;
+        }
+    }
+    int status = vm_exec(prog, count, stats);
+    free(prog);
+    return status;
+}
+
+
+int vm_load_text(const char *path, instruction **code) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Could not open code file '%s'.\n", path);
+        return -1;
+    }
+
+    int count = 0, capacity = 256;
+    instruction *loaded = malloc((size_t)capacity * sizeof(instruction));
+    instruction in;
+    while (loaded && fscanf(fp, "%d %d %d", &in.op, &in.l, &in.m) == 3) {
+        if (count == capacity) {
+            capacity *= 2;
+            instruction *grown = realloc(loaded, (size_t)capacity * sizeof(instruction));
+            if (!grown) {
+                free(loaded);
+                loaded = NULL;
+                break;
+            }
+            loaded = grown;
+        }
+        loaded[count++] = in;
+    }
+    fclose(fp);
+
+    if (!loaded || count == 0) {
+        fprintf(stderr, "Error: No PM/0 code in '%s'.\n", path);
+        free(loaded);
+        return -1;
+    }
+    *code = loaded;
+    return count;
+}
+
+
+#ifndef VM_LIBRARY
+int main(int argc, char *argv[]) {
+    const char *path = CODE_FILENAME;
+    int show_stats = 0, use_jit = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) show_stats = 1;
+        else if (strcmp(argv[i], "--jit") == 0) use_jit = 1;
+        else path = argv[i];
+    }
+
+    vm_stats stats;
+    int status = JIT_UNSUPPORTED;
+    if (obj_is_object(path)) {
+        obj_file obj;
+        if (obj_open(path, &obj) < 0) return EXIT_FAILURE;
+        if (use_jit) {
+            instruction *code;
+            int count = obj_read_code(&obj, &code);
+            if (count >= 0) {
+                status = jit_run(code, count, &stats);
+                free(code);
+            }
+            if (status == JIT_UNSUPPORTED) fprintf(stderr, "JIT unavailable for this code, interpreting\n");
+        }
+        if (status == JIT_UNSUPPORTED) {
+            use_jit = 0;
+            status = vm_run_object(&obj, &stats);
+        }
+        obj_close(&obj);
+    } else {
+        instruction *code;
+        int count = vm_load_text(path, &code);
+        if (count < 0) return EXIT_FAILURE;
+
+        if (use_jit) {
+            status = jit_run(code, count, &stats);
+            if (status == JIT_UNSUPPORTED) fprintf(stderr, "JIT unavailable for this code, interpreting\n");
+        }
+        if (status == JIT_UNSUPPORTED) {
+            use_jit = 0;
+            status = vm_run(code, count, &stats);
+        }
+        free(code);
+    }
+
+    if (show_stats && use_jit) {
+        fprintf(stderr, "native code ran in %.3f s\n", stats.seconds);
+    } else if (show_stats) {
+        fprintf(stderr, "%lld instructions in %.3f s (%.1f million instructions/s)\n",
+                stats.instructions, stats.seconds,
+                stats.seconds > 0 ? stats.instructions / stats.seconds / 1e6 : 0.0);
+    }
+    return status == VM_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
@@ -0,0 +1,47 @@
+/*
+    vm.h - Interface for the PM/0 virtual machine
+
+    Runs the instruction stream produced by parsercodegen.c (code[] in
+    memory, or elf.txt on disk).
+
+    To Compile (library mode, no main() in vm.c):
+        gcc -O2 -std=c11 -DVM_LIBRARY -c vm.c
+    (link with object.c built with -DOBJECT_LIBRARY)
+*/
+
+#ifndef VM_H
+#define VM_H
+
+#include "parsercodegen.h"
+#include "object.h"
+
+// Words of stack preallocated for a run
+#define VM_STACK_SIZE (1 << 20)
+
+// Calls active at once: as many activation records as the stack holds.
+// Also the deepest static level (L) the VM accepts.
+#define VM_MAX_CALLS (VM_STACK_SIZE / 3 + 1)
+
+// vm_run() results; VM_BAD_CODE is also a RTN to a corrupted activation
+// record
+enum vm_status {
+    VM_OK = 0, VM_BAD_CODE, VM_STACK_OVERFLOW, VM_DIVIDE_BY_ZERO, VM_STACK_UNDERFLOW
+};
+
+typedef struct {
+    long long instructions; // instructions executed
+    double seconds;         // wall time of the run
+} vm_stats;
+
+// Execute count instructions starting at code[0] until SYS 0 3 (halt);
+// stats may be NULL
+int vm_run(const instruction *code, int count, vm_stats *stats);
+
+// Execute a mapped object file without unpacking it to instruction[] first
+int vm_run_object(const obj_file *obj, vm_stats *stats);
+
+// Load an elf.txt style file ("OP L M" per line) into a malloc'd array;
+// returns the instruction count or -1
+int vm_load_text(const char *path, instruction **code);
+
+#endif